@@ -0,0 +1,87 @@
+/*
+ * backoff.h
+ *
+ *  Contention policies for the LLX/SCX retry loops. After a failed
+ *  attempt an update can wait a random number of spins below a per-thread
+ *  window that doubles on every failure and halves on every commit
+ *  (MODE_BACKOFF). weak_llx can give the owner of an in-progress SCX a
+ *  per-thread number of spins to finish before helping it (MODE_LAZY_HELP);
+ *  that budget grows while owners finish in time and shrinks when the
+ *  thread has to help anyway, so helping stays bounded and lock-freedom is
+ *  kept. Both defaults can be overridden with -D at compile time.
+ */
+
+#ifndef BACKOFF_H_
+#define BACKOFF_H_
+
+#include "scx_stats.h"
+
+#ifndef BACKOFF_MIN
+#define BACKOFF_MIN				16   // spins, window after a commit
+#endif
+#ifndef BACKOFF_MAX
+#define BACKOFF_MAX				4096 // spins, power of 2
+#endif
+#ifndef HELP_SPINS_MIN
+#define HELP_SPINS_MIN			8
+#endif
+#ifndef HELP_SPINS_MAX
+#define HELP_SPINS_MAX			1024
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BACKOFF_PAUSE()			__builtin_ia32_pause()
+#else
+#define BACKOFF_PAUSE()			__asm__ __volatile__("" ::: "memory")
+#endif
+
+static __thread unsigned int backoff_window = BACKOFF_MIN;
+static __thread unsigned int help_spins = HELP_SPINS_MIN;
+static __thread unsigned long backoff_seed = 0;
+
+static inline unsigned long backoff_random() {
+	if (!backoff_seed)
+		backoff_seed = (unsigned long) &backoff_seed | 1; // distinct per thread
+	backoff_seed ^= backoff_seed << 13;
+	backoff_seed ^= backoff_seed >> 7;
+	backoff_seed ^= backoff_seed << 17;
+	return backoff_seed;
+}
+
+// after an aborted SCX or a create_* that found a frozen node
+static inline void backoff_abort() {
+	const unsigned int spins = backoff_random() & (backoff_window - 1);
+	STAT_INC(backoffs);
+	STAT_ADD(backoff_spins, spins);
+	for (unsigned int i = 0; i < spins; ++i)
+		BACKOFF_PAUSE();
+	if (backoff_window < BACKOFF_MAX)
+		backoff_window <<= 1;
+}
+
+static inline void backoff_commit() {
+	if (backoff_window > BACKOFF_MIN)
+		backoff_window >>= 1;
+}
+
+/*
+ * Waits for *state to leave in_progress. Returns true if it did not, in
+ * which case the caller helps.
+ */
+static inline bool help_wait(volatile int* state, const int in_progress) {
+	STAT_INC(help_waits);
+	for (unsigned int i = 0; i < help_spins; ++i) {
+		if (*state != in_progress) {
+			STAT_INC(help_skips);
+			if (help_spins < HELP_SPINS_MAX)
+				help_spins <<= 1;
+			return false;
+		}
+		BACKOFF_PAUSE();
+	}
+	if (help_spins > HELP_SPINS_MIN)
+		help_spins >>= 1;
+	return *state == in_progress;
+}
+
+#endif /* BACKOFF_H_ */
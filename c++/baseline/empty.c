@@ -0,0 +1,33 @@
+/*
+ * empty.c
+ *
+ *  Self-check for the benchmark driver: a set whose operations return at
+ *  once. Its throughput is the ceiling the harness itself allows (key
+ *  generation, the function table call, counters and instrumentation).
+ */
+
+#include <jemalloc/jemalloc.h>
+#include "../engine.h"
+
+#define true 					1
+#define false 					0
+
+#define null					0
+
+#define SUCCESS 				0
+
+static int empty_init(const int violations) {
+	return SUCCESS;
+}
+
+static bool empty_op(const unsigned long key) {
+	return false;
+}
+
+static int empty_zero() {
+	return 0;
+}
+
+const engine_t empty_engine = { "empty", false, empty_init, empty_op, empty_op,
+		empty_op, empty_zero, empty_zero, null, null, null, null, null, null,
+		null, 0, null, null, null, null, null, null };
@@ -0,0 +1,314 @@
+/*
+ * rbtree.c
+ *
+ *  Baseline for the benchmark driver: a sequential red-black tree
+ *  (Cormen et al., chapter 13) behind one pthread mutex. Every operation,
+ *  including get, holds the lock.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <jemalloc/jemalloc.h>
+#include "../engine.h"
+
+#define true 					1
+#define false 					0
+
+#define null					0
+
+#define SUCCESS 				0
+
+typedef struct rb_node {
+	struct rb_node* left;
+	struct rb_node* right;
+	struct rb_node* parent;
+	unsigned long key;
+	bool red;
+} rb_node_t;
+
+static rb_node_t nil_node;
+static rb_node_t* const nil = &nil_node; // shared black leaf
+static rb_node_t* root = null;
+static int count = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void free_node(rb_node_t* node) {
+	if (node == nil)
+		return;
+	free_node(node->left);
+	free_node(node->right);
+	free(node);
+}
+
+static int rb_init(const int violations) {
+	if (root)
+		free_node(root);
+	nil->left = nil->right = nil->parent = nil;
+	nil->red = false;
+	root = nil;
+	count = 0;
+	return SUCCESS;
+}
+
+static rb_node_t* find(const unsigned long key) {
+	rb_node_t* x = root;
+	while (x != nil && x->key != key)
+		x = key < x->key ? x->left : x->right;
+	return x;
+}
+
+static void rotate_left(rb_node_t* x) {
+	rb_node_t* y = x->right;
+	x->right = y->left;
+	if (y->left != nil)
+		y->left->parent = x;
+	y->parent = x->parent;
+	if (x->parent == nil)
+		root = y;
+	else if (x == x->parent->left)
+		x->parent->left = y;
+	else
+		x->parent->right = y;
+	y->left = x;
+	x->parent = y;
+}
+
+static void rotate_right(rb_node_t* x) {
+	rb_node_t* y = x->left;
+	x->left = y->right;
+	if (y->right != nil)
+		y->right->parent = x;
+	y->parent = x->parent;
+	if (x->parent == nil)
+		root = y;
+	else if (x == x->parent->right)
+		x->parent->right = y;
+	else
+		x->parent->left = y;
+	y->right = x;
+	x->parent = y;
+}
+
+static void insert_fixup(rb_node_t* z) {
+	while (z->parent->red) {
+		rb_node_t* g = z->parent->parent;
+		if (z->parent == g->left) {
+			rb_node_t* y = g->right;
+			if (y->red) {
+				z->parent->red = false;
+				y->red = false;
+				g->red = true;
+				z = g;
+			} else {
+				if (z == z->parent->right) {
+					z = z->parent;
+					rotate_left(z);
+				}
+				z->parent->red = false;
+				z->parent->parent->red = true;
+				rotate_right(z->parent->parent);
+			}
+		} else {
+			rb_node_t* y = g->left;
+			if (y->red) {
+				z->parent->red = false;
+				y->red = false;
+				g->red = true;
+				z = g;
+			} else {
+				if (z == z->parent->left) {
+					z = z->parent;
+					rotate_right(z);
+				}
+				z->parent->red = false;
+				z->parent->parent->red = true;
+				rotate_left(z->parent->parent);
+			}
+		}
+	}
+	root->red = false;
+}
+
+static void transplant(rb_node_t* u, rb_node_t* v) {
+	if (u->parent == nil)
+		root = v;
+	else if (u == u->parent->left)
+		u->parent->left = v;
+	else
+		u->parent->right = v;
+	v->parent = u->parent;
+}
+
+static void delete_fixup(rb_node_t* x) {
+	while (x != root && !x->red) {
+		if (x == x->parent->left) {
+			rb_node_t* w = x->parent->right;
+			if (w->red) {
+				w->red = false;
+				x->parent->red = true;
+				rotate_left(x->parent);
+				w = x->parent->right;
+			}
+			if (!w->left->red && !w->right->red) {
+				w->red = true;
+				x = x->parent;
+			} else {
+				if (!w->right->red) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right(w);
+					w = x->parent->right;
+				}
+				w->red = x->parent->red;
+				x->parent->red = false;
+				w->right->red = false;
+				rotate_left(x->parent);
+				x = root;
+			}
+		} else {
+			rb_node_t* w = x->parent->left;
+			if (w->red) {
+				w->red = false;
+				x->parent->red = true;
+				rotate_right(x->parent);
+				w = x->parent->left;
+			}
+			if (!w->right->red && !w->left->red) {
+				w->red = true;
+				x = x->parent;
+			} else {
+				if (!w->left->red) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left(w);
+					w = x->parent->left;
+				}
+				w->red = x->parent->red;
+				x->parent->red = false;
+				w->left->red = false;
+				rotate_right(x->parent);
+				x = root;
+			}
+		}
+	}
+	x->red = false;
+}
+
+static bool rb_get(const unsigned long key) {
+	pthread_mutex_lock(&lock);
+	const bool found = find(key) != nil;
+	pthread_mutex_unlock(&lock);
+	return found;
+}
+
+static bool rb_insert(const unsigned long key) {
+	rb_node_t* z = (rb_node_t*) malloc(sizeof(rb_node_t));
+	if (!z) {
+		perror("malloc");
+		exit(1);
+	}
+	z->key = key;
+	z->left = z->right = nil;
+	z->red = true;
+
+	pthread_mutex_lock(&lock);
+	rb_node_t* y = nil;
+	rb_node_t* x = root;
+	while (x != nil) {
+		y = x;
+		if (key == x->key) {
+			pthread_mutex_unlock(&lock);
+			free(z);
+			return false;
+		}
+		x = key < x->key ? x->left : x->right;
+	}
+	z->parent = y;
+	if (y == nil)
+		root = z;
+	else if (key < y->key)
+		y->left = z;
+	else
+		y->right = z;
+	insert_fixup(z);
+	count++;
+	pthread_mutex_unlock(&lock);
+	return true;
+}
+
+static bool rb_delete(const unsigned long key) {
+	pthread_mutex_lock(&lock);
+	rb_node_t* z = find(key);
+	if (z == nil) {
+		pthread_mutex_unlock(&lock);
+		return false;
+	}
+	rb_node_t* y = z;
+	rb_node_t* x;
+	bool y_red = y->red;
+	if (z->left == nil) {
+		x = z->right;
+		transplant(z, z->right);
+	} else if (z->right == nil) {
+		x = z->left;
+		transplant(z, z->left);
+	} else {
+		y = z->right;
+		while (y->left != nil)
+			y = y->left;
+		y_red = y->red;
+		x = y->right;
+		if (y->parent == z) {
+			x->parent = y;
+		} else {
+			transplant(y, y->right);
+			y->right = z->right;
+			y->right->parent = y;
+		}
+		transplant(z, y);
+		y->left = z->left;
+		y->left->parent = y;
+		y->red = z->red;
+	}
+	if (!y_red)
+		delete_fixup(x);
+	count--;
+	pthread_mutex_unlock(&lock);
+	free(z);
+	return true;
+}
+
+static int height_node(const rb_node_t* node) {
+	if (node == nil)
+		return 0;
+	const int l = height_node(node->left);
+	const int r = height_node(node->right);
+	return 1 + (l > r ? l : r);
+}
+
+static int rb_height() {
+	pthread_mutex_lock(&lock);
+	const int h = height_node(root);
+	pthread_mutex_unlock(&lock);
+	return h;
+}
+
+static int rb_size() {
+	return count;
+}
+
+// deleted nodes are freed, so the live nodes are the keys and nil
+static void rb_footprint(mem_footprint_t* m) {
+	pthread_mutex_lock(&lock);
+	m->nodes = count + 1;
+	pthread_mutex_unlock(&lock);
+	m->ops = 0;
+	m->node_size = sizeof(rb_node_t);
+	m->op_size = 0;
+	m->bytes = m->nodes * m->node_size;
+	m->aux_bytes = 0;
+}
+
+const engine_t rbtree_engine = { "rbtree", false, rb_init, rb_get, rb_insert,
+		rb_delete, rb_height, rb_size, null, null, null, null, null, null,
+		rb_footprint, 0, null, null, null, null, null, null };
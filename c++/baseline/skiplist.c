@@ -0,0 +1,217 @@
+/*
+ * skiplist.c
+ *
+ *  Baseline for the benchmark driver: the lock-free skip list of Herlihy
+ *  and Shavit ("The Art of Multiprocessor Programming", 14.4), with the
+ *  deletion mark kept in the low bit of each next pointer. An insert that
+ *  finds its node marked while linking the upper levels stops linking.
+ *  Like the trees, nodes are never reclaimed.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <jemalloc/jemalloc.h>
+#include "atomic_ops.h"
+#include "../engine.h"
+
+#define true 					1
+#define false 					0
+
+#define null					0
+
+#define SUCCESS 				0
+
+#define SL_MAX_LEVEL			32
+
+typedef struct sl_node {
+	unsigned long key;
+	int top_level;
+	struct sl_node* volatile next[]; // top_level + 1 entries
+} sl_node_t;
+
+#define MARKED(p)				(((uintptr_t) (p)) & 1)
+#define MARK(p)					((sl_node_t*) (((uintptr_t) (p)) | 1))
+#define UNMARK(p)				((sl_node_t*) (((uintptr_t) (p)) & ~(uintptr_t) 1))
+#define CAS(addr, old, new)		AO_compare_and_swap((AO_t*) (addr), (AO_t) (old), \
+		(AO_t) (new))
+
+static sl_node_t* head = null;
+static sl_node_t* tail = null;
+static __thread unsigned long level_seed = 0;
+
+static sl_node_t* new_node(const unsigned long key, const int top_level) {
+	sl_node_t* node = (sl_node_t*) malloc(sizeof(sl_node_t)
+			+ (top_level + 1) * sizeof(sl_node_t*));
+	if (!node) {
+		perror("malloc");
+		exit(1);
+	}
+	node->key = key;
+	node->top_level = top_level;
+	return node;
+}
+
+// geometric with p = 1/2, from a per-thread xorshift generator
+static int random_level() {
+	if (!level_seed)
+		level_seed = (unsigned long) &level_seed | 1;
+	level_seed ^= level_seed << 13;
+	level_seed ^= level_seed >> 7;
+	level_seed ^= level_seed << 17;
+	return __builtin_ctzl(level_seed | (1UL << (SL_MAX_LEVEL - 1)));
+}
+
+static int sl_init(const int violations) {
+	head = new_node(0, SL_MAX_LEVEL - 1);
+	tail = new_node(ULONG_MAX, SL_MAX_LEVEL - 1);
+	for (int i = 0; i < SL_MAX_LEVEL; ++i) {
+		head->next[i] = tail;
+		tail->next[i] = null;
+	}
+	return SUCCESS;
+}
+
+// fills preds/succs around key at every level, unlinking marked nodes
+static bool find(const unsigned long key, sl_node_t** preds, sl_node_t** succs) {
+	sl_node_t* pred;
+	sl_node_t* curr;
+retry:
+	pred = head;
+	curr = null;
+	for (int level = SL_MAX_LEVEL - 1; level >= 0; --level) {
+		curr = UNMARK(pred->next[level]);
+		while (true) {
+			sl_node_t* succ = curr->next[level];
+			while (MARKED(succ)) {
+				if (!CAS(&pred->next[level], curr, UNMARK(succ)))
+					goto retry;
+				curr = UNMARK(pred->next[level]);
+				succ = curr->next[level];
+			}
+			if (curr->key < key) {
+				pred = curr;
+				curr = UNMARK(succ);
+			} else {
+				break;
+			}
+		}
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+	return curr->key == key;
+}
+
+static bool sl_get(const unsigned long key) {
+	sl_node_t* pred = head;
+	sl_node_t* curr = null;
+	for (int level = SL_MAX_LEVEL - 1; level >= 0; --level) {
+		curr = UNMARK(pred->next[level]);
+		while (true) {
+			sl_node_t* succ = curr->next[level];
+			while (MARKED(succ)) {
+				curr = UNMARK(succ);
+				succ = curr->next[level];
+			}
+			if (curr->key < key) {
+				pred = curr;
+				curr = UNMARK(succ);
+			} else {
+				break;
+			}
+		}
+	}
+	return curr->key == key;
+}
+
+static bool sl_insert(const unsigned long key) {
+	sl_node_t* preds[SL_MAX_LEVEL];
+	sl_node_t* succs[SL_MAX_LEVEL];
+	const int top_level = random_level();
+	sl_node_t* node = null;
+	while (true) {
+		if (find(key, preds, succs)) {
+			free(node);
+			return false;
+		}
+		if (!node)
+			node = new_node(key, top_level);
+		for (int level = 0; level <= top_level; ++level)
+			node->next[level] = succs[level];
+		if (CAS(&preds[0]->next[0], succs[0], node))
+			break;
+	}
+	for (int level = 1; level <= top_level; ++level) {
+		while (true) {
+			sl_node_t* next = node->next[level];
+			if (MARKED(next))
+				return true; // being deleted, leave the upper levels
+			if (next != succs[level] && !CAS(&node->next[level], next, succs[level]))
+				return true;
+			if (CAS(&preds[level]->next[level], succs[level], node))
+				break;
+			find(key, preds, succs);
+		}
+	}
+	return true;
+}
+
+static bool sl_delete(const unsigned long key) {
+	sl_node_t* preds[SL_MAX_LEVEL];
+	sl_node_t* succs[SL_MAX_LEVEL];
+	if (!find(key, preds, succs))
+		return false;
+	sl_node_t* victim = succs[0];
+	for (int level = victim->top_level; level >= 1; --level) {
+		sl_node_t* succ = victim->next[level];
+		while (!MARKED(succ)) {
+			CAS(&victim->next[level], succ, MARK(succ));
+			succ = victim->next[level];
+		}
+	}
+	sl_node_t* succ = victim->next[0];
+	while (true) {
+		if (MARKED(succ))
+			return false; // another delete won
+		if (CAS(&victim->next[0], succ, MARK(succ))) {
+			find(key, preds, succs);
+			return true;
+		}
+		succ = victim->next[0];
+	}
+}
+
+// number of non-empty levels
+static int sl_height() {
+	int level = SL_MAX_LEVEL - 1;
+	while (level > 0 && UNMARK(head->next[level]) == tail)
+		--level;
+	return level + 1;
+}
+
+static int sl_size() {
+	int size = 0;
+	for (sl_node_t* n = UNMARK(head->next[0]); n != tail; n = UNMARK(n->next[0]))
+		if (!MARKED(n->next[0]))
+			size++;
+	return size;
+}
+
+// every node still linked at the bottom level, head and tail included;
+// nodes are as tall as their level, so node_size is left 0
+static void sl_footprint(mem_footprint_t* m) {
+	m->nodes = 0;
+	m->ops = 0;
+	m->bytes = 0;
+	m->aux_bytes = 0;
+	m->node_size = 0;
+	m->op_size = 0;
+	for (sl_node_t* n = head; n; n = UNMARK(n->next[0])) {
+		m->nodes++;
+		m->bytes += sizeof(sl_node_t) + (n->top_level + 1) * sizeof(sl_node_t*);
+	}
+}
+
+const engine_t skiplist_engine = { "skiplist", false, sl_init, sl_get,
+		sl_insert, sl_delete, sl_height, sl_size, null, null, null, null, null,
+		null, sl_footprint, 0, null, null, null, null, null, null };
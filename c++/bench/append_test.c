@@ -0,0 +1,67 @@
+/*
+ * append_test.c
+ *
+ *  Checks that MODE_APPEND keeps the trees within d violations per path:
+ *  several threads each append fewer than APPEND_FIX_BATCH keys and stop,
+ *  which leaves every thread's batch unfinished, and once they are gone
+ *  no root-to-leaf path may hold more than d violations (none for d = 0).
+ *  Exits non-zero on failure.
+ *
+ *  make append_test && ./append_test
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "atomic_ops.h"
+#include "../engine.h"
+
+#define TEST_THREADS			8
+#define TEST_APPENDS			(APPEND_FIX_BATCH - 1) // per thread
+
+static const engine_t* engine;
+static volatile unsigned long next_key; // handed out in increasing order
+
+static void* append_run(void* arg) {
+	for (int i = 0; i < TEST_APPENDS; ++i)
+		engine->insert(AO_fetch_and_add_full((AO_t*) &next_key, 1));
+	return NULL;
+}
+
+// appends from TEST_THREADS threads to an empty set; false if a path
+// holds more than d violations
+static bool append_burst(const engine_t* e, const int d) {
+	engine = e;
+	next_key = 1;
+	e->set_modes(MODE_APPEND);
+	e->init(d);
+	pthread_t threads[TEST_THREADS];
+	for (int i = 0; i < TEST_THREADS; i++) {
+		if (pthread_create(&threads[i], NULL, append_run, NULL) != 0) {
+			fprintf(stderr, "Error creating thread\n");
+			exit(1);
+		}
+	}
+	for (int i = 0; i < TEST_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	tree_stats_t s;
+	stats_clear(&s);
+	e->tree_stats(&s, 1);
+	const bool ok = e->size() == TEST_THREADS * TEST_APPENDS
+			&& s.path_violations <= d;
+	printf("%s d=%d keys=%d path_violations=%lu height=%d %s\n", e->name,
+			d, e->size(), s.path_violations, e->height(), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main() {
+	const engine_t* engines[] = { &ravl_engine, &chromatic_engine };
+	const int ds[] = { 0, 1, 4, APPEND_FIX_BATCH, 2 * APPEND_FIX_BATCH };
+	bool ok = true;
+	for (int e = 0; e < 2; e++)
+		for (int i = 0; i < sizeof(ds) / sizeof(ds[0]); i++)
+			ok &= append_burst(engines[e], ds[i]);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,1640 @@
+/*
+ * bench.c
+ *
+ *  Benchmark driver for the sets registered in engine.h. One run is made
+ *  for every combination of the engines, numbers of violations d and
+ *  thread counts given on the command line; each run prints one CSV line
+ *  and, with --json, one JSON object per line.
+ *
+ *  Based on the per-tree test.c harness, created on: Nov 15, 2015
+ *      Author: mengdu
+ */
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "bench.h"
+#include "atomic_ops.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include "../common_ops.h"
+#include "../latency.h"
+#include "../workload.h"
+#include "../zipf.h"
+#include "../trace.h"
+#include "../replay.h"
+#include "../perf.h"
+#include "../engine.h"
+#include "../sampler.h"
+
+#define DEFAULT_DURATION                1000
+#define DEFAULT_INITIAL                 256
+#define DEFAULT_NB_THREADS              32
+#define DEFAULT_RANGE                   0x7FFFFFFF
+#define DEFAULT_SEED                    0
+#define DEFAULT_UPDATE                  20
+#define DEFAULT_ELASTICITY              4
+#define DEFAULT_ALTERNATE               0
+#define DEFAULT_EFFECTIVE               0
+#define DEFAULT_INSERT_RATIO			50
+#define BLOCK_SIZE						1000
+#define DEFAULT_PRESORTEDNESS			0
+#define DEFAULT_STREAM_OPS				(1 << 20)
+#define DEFAULT_ENGINE					"dwrbavl"
+#define MAX_SWEEP						64
+#define OPT_SAMPLE_HEIGHT				256 // long only, every letter is taken
+int key_dist = UNIFORM;
+double alpha = 0;
+zipf_t zipf;
+unsigned long sampler_bench = 0;
+int real_file = AOL;
+unsigned long* query_from_file = NULL;
+unsigned long query_size = 0;
+unsigned long* uniq_query_from_file = NULL;
+unsigned long uniq_query_size = 0;
+/* presortedness initial keys and operations */
+int presortedness = DEFAULT_PRESORTEDNESS;
+int p_dup = 0;
+char presortedness_file_name[20];
+unsigned long* p_init_keys = NULL;
+unsigned long p_init_keys_size = 0;
+unsigned long* p_ops = NULL;
+unsigned long p_ops_size = 0;
+/* latency sampling (0 = off) and optional JSON report file */
+unsigned long latency_period = 0;
+char* latency_json = NULL;
+/* tree shape report threads (0 = off) and time series interval in ms */
+int shape_threads = 0;
+int shape_interval = 0;
+/* pre-generated operation streams: ops per thread, optional backing file */
+int online = 0;
+unsigned long stream_ops = DEFAULT_STREAM_OPS;
+char* stream_file = NULL;
+/* binary trace file to read the real/presortedness data from, or to write */
+char* trace_file = NULL;
+char* convert_file = NULL;
+trace_t trace;
+/* operation record/replay files; replays run at full speed unless paced */
+char* record_file = NULL;
+char* replay_file = NULL;
+int replay_rate = 0;
+trace_t replay;
+op_record_t prefill_rec;
+/* open-loop target in ops/sec over all threads (0 = closed loop) */
+unsigned long target_rate = 0;
+double tsc_ticks_per_ns = 0;
+/* per-thread event counters around the timed region */
+int perf_mode = PERF_OFF;
+/* engines, numbers of violations and thread counts to sweep */
+const engine_t* registry[] = { &ravl_engine, &chromatic_engine, &rbtree_engine,
+		&skiplist_engine, &empty_engine, null };
+const engine_t* engines[MAX_SWEEP];
+int nb_engines = 0;
+int violations[MAX_SWEEP] = { 0 };
+int nb_violations = 1;
+int thread_counts[MAX_SWEEP] = { DEFAULT_NB_THREADS };
+int nb_thread_counts = 1;
+/* one JSON object per run (null = off) */
+char* json_file = NULL;
+FILE* json_out = NULL;
+/* time series interval and warm-up excluded from the summary, in ms */
+int sample_interval = 0;
+int sample_height = 0;
+int warmup = 0;
+/* run the empty set before the sweep */
+int self_check = 0;
+/* threads that populate the set, 0 for nb_threads */
+int prefill_threads = 1;
+/* MODE_* flags requested on the command line */
+int modes = 0;
+/* percent of reads issued as rank queries in MODE_RANK */
+int rank_reads = 0;
+/* threads that scan the whole set during a run, in MODE_SNAPSHOT */
+int scanners = 0;
+/* key values a delete removes at once with delete_range, 0 for delete */
+unsigned long range_width = 0;
+volatile unsigned long warmup_done;
+/* engine of the current run */
+const engine_t* engine;
+const char* stats_gap_name = "";
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+//#define THROTTLE_NUM  1000
+//#define THROTTLE_TIME 10000
+//#define THROTTLE_MAINTENANCE
+
+volatile AO_t stop;
+unsigned int global_seed;
+#ifdef TLS
+__thread unsigned int *rng_seed;
+#else /* ! TLS */
+pthread_key_t rng_seed_key;
+#endif /* ! TLS */
+unsigned int levelmax;
+
+typedef struct run_config {
+	int duration;
+	int initial;
+	unsigned long range;
+	unsigned seed;
+	int update;
+	int insert_ratio;
+	int alternate;
+	int effective;
+} run_config_t;
+
+void *xmalloc(size_t size) {
+  void *p = malloc(size);
+  if (p == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  return p;
+}
+
+/* tree_stats.h entry point, used by stats_series */
+void tree_stats(tree_stats_t* s, const int nthreads) {
+	if (engine->tree_stats)
+		engine->tree_stats(s, nthreads);
+}
+
+/* comma separated integers into out; returns how many */
+int parse_list(char* arg, int* out) {
+	int n = 0;
+	for (char* tok = strtok(arg, ","); tok && n < MAX_SWEEP;
+			tok = strtok(NULL, ","))
+		out[n++] = atoi(tok);
+	return n;
+}
+
+const engine_t* find_engine(const char* name) {
+	for (int i = 0; registry[i]; ++i)
+		if (strcmp(registry[i]->name, name) == 0)
+			return registry[i];
+	fprintf(stderr, "unknown engine %s\n", name);
+	exit(1);
+}
+
+void barrier_init(barrier_t *b, int n) {
+	pthread_cond_init(&b->complete, NULL);
+	pthread_mutex_init(&b->mutex, NULL);
+	b->count = n;
+	b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b) {
+	pthread_mutex_lock(&b->mutex);
+	/* One more thread through */
+	b->crossing++;
+	/* If not all here, wait */
+	if (b->crossing < b->count) {
+		pthread_cond_wait(&b->complete, &b->mutex);
+	} else {
+		pthread_cond_broadcast(&b->complete);
+		/* Reset for next time */
+		b->crossing = 0;
+	}
+	pthread_mutex_unlock(&b->mutex);
+}
+
+unsigned long rand_key(gsl_rng* r, const unsigned long range) {
+	if (key_dist == ZIPF_RI || key_dist == ZIPF_SCRAMBLED)
+		return zipf_next(&zipf, r, key_dist == ZIPF_SCRAMBLED);
+	return rand_gsl(r, range, key_dist);
+}
+
+typedef struct op_gen {
+	gsl_rng* r;
+	double insert_ratio;
+	double update_ratio;
+	int round;
+	int counter;
+} op_gen_t;
+
+void op_gen_init(op_gen_t* g, thread_data_t* d) {
+	/* allocated by the worker itself; gsl_rng_env_setup ran in main */
+	g->r = gsl_rng_alloc(gsl_rng_default);
+	gsl_rng_set(g->r, d->seed);
+	g->insert_ratio = (double)d->insert / 100 * (double)d->update / 100;
+	g->update_ratio = (double)d->update / 100;
+	g->round = 0;
+	g->counter = 0;
+}
+
+/* next operation of the random (or real data) workload */
+int next_op(thread_data_t* d, op_gen_t* g, unsigned long* val) {
+	long real_data_index = 0;
+	if (key_dist == REAL) {
+		if (g->counter == 1000) {
+			++g->round;
+			g->counter = 0;
+		}
+		real_data_index = BLOCK_SIZE * (g->round * d->numThreads + d->id) + g->counter;
+		if (real_data_index >= query_size) {
+			real_data_index = 0;
+			g->counter = 0;
+			g->round = 0;
+		}
+		g->counter++;
+	}
+	*val = (key_dist == REAL) ? query_from_file[real_data_index] : rand_key(g->r, d->range);
+	const double operation = gsl_rng_uniform(g->r);
+	assert(*val > 0);
+	if (operation < g->insert_ratio)
+		return OP_INSERT;
+	if (operation < g->update_ratio)
+		return OP_DELETE;
+	return OP_GET;
+}
+
+/* operation number index of the presortedness workload */
+int next_p_op(thread_data_t* d, op_gen_t* g, const unsigned long index,
+		unsigned long* val) {
+	const double operation = gsl_rng_uniform(g->r);
+	if (p_dup) {
+		*val = p_ops[index];
+		if (operation < g->insert_ratio)
+			return OP_INSERT;
+		return operation < g->update_ratio ? OP_DELETE : OP_GET;
+	}
+	if (operation < g->insert_ratio) {
+		*val = p_ops[index];
+		return OP_INSERT;
+	}
+//	val = p_ops[(int)(index * gsl_rng_uniform(r))];
+	*val = rand_gsl(g->r, d->range, UNIFORM);
+	return operation < g->update_ratio ? OP_DELETE : OP_GET;
+}
+
+/* per-thread clocks start when the thread leaves the barrier; open-loop
+ * schedules are staggered so the threads do not issue in lockstep */
+static inline unsigned long run_start(thread_data_t* d) {
+	const unsigned long now = read_tsc();
+	if (d->rec)
+		d->rec->start = now;
+	d->intended = now + d->interval * d->id / d->numThreads;
+	d->fix_ticks = engine->fix_ticks ? engine->fix_ticks() : null;
+	perf_start(d->perf);
+	return now;
+}
+
+/* open loop: waits for the intended start of the next operation and
+ * returns it, so latency includes the time the operation was queued */
+static inline unsigned long open_loop_next(thread_data_t* d) {
+	const unsigned long intended = d->intended;
+	while (read_tsc() < intended && stop == 0)
+		;
+	d->intended += d->interval;
+	return intended;
+}
+
+/* warm-up over: restart everything the summary is built from */
+static void warmup_reset(thread_data_t* d) {
+	d->nb_add = 0;
+	d->nb_added = 0;
+	d->nb_remove = 0;
+	d->nb_removed = 0;
+	d->nb_contains = 0;
+	d->nb_found = 0;
+	d->nb_range = 0;
+	d->nb_range_keys = 0;
+	if (d->lat)
+		lat_init(d->lat, d->lat->period);
+	perf_start(d->perf);
+	d->warming = 0;
+}
+
+static inline void apply_op(thread_data_t* d, const int op,
+		const unsigned long val) {
+	if (d->warming && warmup_done)
+		warmup_reset(d);
+	if (d->progress)
+		d->progress->ops++;
+	const unsigned long intended = d->interval ? open_loop_next(d) : 0;
+	if (d->rec)
+		rec_append(d->rec, op, val);
+	if (op == OP_INSERT) {
+		lat_start_at(d->lat, intended);
+		if(engine->insert(val)) {
+			lat_stop(d->lat, LAT_INSERT_OK);
+			d->nb_added++;
+			if (d->progress)
+				d->progress->keys++;
+		} else {
+			lat_stop(d->lat, LAT_INSERT_FAIL);
+		}
+		lat_fix(d->lat, d->fix_ticks);
+		d->nb_add++;
+
+	} else if (op == OP_DELETE && range_width && engine->delete_range) {
+		lat_start_at(d->lat, intended);
+		const unsigned long keys = engine->delete_range(val,
+				val + range_width - 1);
+		if (keys) {
+			lat_stop(d->lat, LAT_DELETE_OK);
+			d->nb_range_keys += keys;
+			if (d->progress)
+				d->progress->keys -= keys;
+		} else {
+			lat_stop(d->lat, LAT_DELETE_FAIL);
+		}
+		lat_fix(d->lat, d->fix_ticks);
+		d->nb_range++;
+	} else if (op == OP_DELETE) {
+		lat_start_at(d->lat, intended);
+		if(engine->delete(val)) {
+			lat_stop(d->lat, LAT_DELETE_OK);
+			d->nb_removed++;
+			if (d->progress)
+				d->progress->keys--;
+		} else {
+			lat_stop(d->lat, LAT_DELETE_FAIL);
+		}
+		lat_fix(d->lat, d->fix_ticks);
+		d->nb_remove++;
+	} else if (rank_reads && (modes & engine->modes & MODE_RANK)
+			&& d->nb_contains % 100 < rank_reads) {
+		lat_start_at(d->lat, intended);
+		engine->rank(val);
+		lat_stop(d->lat, LAT_GET);
+		d->nb_contains++;
+	} else {
+		lat_start_at(d->lat, intended);
+		if(engine->get(val)) {
+			d->nb_found++;
+		}
+		lat_stop(d->lat, LAT_GET);
+		d->nb_contains++;
+	}
+}
+
+void *p_test(void* data) {
+
+	thread_data_t *d = (thread_data_t *) data;
+	unsigned long val = 0;
+	op_gen_t g;
+	op_gen_init(&g, d);
+	if (d->stream) {
+		unsigned long n = 0;
+		for (unsigned long index = d->id; index < p_ops_size; index += d->numThreads) {
+			const int op = next_p_op(d, &g, index, &val);
+			d->stream[n++] = stream_pack(op, val);
+		}
+		d->stream_len = n;
+	}
+	if (d->perf)
+		perf_open(d->perf, perf_mode);
+	/* Wait on barrier */
+	barrier_cross(d->barrier);
+	run_start(d);
+	if (d->stream) {
+		for (unsigned long i = 0; i < d->stream_len; ++i)
+			apply_op(d, stream_op(d->stream[i]), stream_key(d->stream[i]));
+	} else {
+		for (unsigned long index = d->id; index < p_ops_size; index += d->numThreads) {
+			const int op = next_p_op(d, &g, index, &val);
+			apply_op(d, op, val);
+		}
+	}
+	perf_stop(d->perf);
+#ifdef SCX_STATS
+	if (engine->scx_stats)
+		engine->scx_stats(&d->scx);
+#endif
+#ifdef MEM_STATS
+	if (engine->mem_stats)
+		engine->mem_stats(&d->mem);
+#endif
+	gsl_rng_free(g.r);
+	return NULL;
+}
+
+void *test(void *data) {
+	thread_data_t *d = (thread_data_t *) data;
+	unsigned long val = 0;
+	op_gen_t g;
+	op_gen_init(&g, d);
+	if (d->stream) {
+		for (unsigned long i = 0; i < d->stream_len; ++i) {
+			const int op = next_op(d, &g, &val);
+			d->stream[i] = stream_pack(op, val);
+		}
+	}
+	if (d->perf)
+		perf_open(d->perf, perf_mode);
+	/* Wait on barrier */
+	barrier_cross(d->barrier);
+	run_start(d);
+	if (d->stream) {
+		/* replay the stream, wrapping around until the run ends */
+		unsigned long i = 0;
+		while (stop == 0) {
+			apply_op(d, stream_op(d->stream[i]), stream_key(d->stream[i]));
+			if (++i == d->stream_len)
+				i = 0;
+		}
+	} else {
+		//#ifdef ICC
+		while (stop == 0) {
+			const int op = next_op(d, &g, &val);
+			apply_op(d, op, val);
+		}
+	}
+	perf_stop(d->perf);
+#ifdef SCX_STATS
+	if (engine->scx_stats)
+		engine->scx_stats(&d->scx);
+#endif
+#ifdef MEM_STATS
+	if (engine->mem_stats)
+		engine->mem_stats(&d->mem);
+#endif
+	gsl_rng_free(g.r);
+
+	return NULL;
+}
+
+/* re-drives a recorded operation sequence, optionally at its recorded pace */
+void *r_test(void* data) {
+	thread_data_t *d = (thread_data_t *) data;
+	if (d->perf)
+		perf_open(d->perf, perf_mode);
+	/* Wait on barrier */
+	barrier_cross(d->barrier);
+	const unsigned long start = run_start(d);
+	for (unsigned long i = 0; i < d->stream_len; ++i) {
+		if (d->replay_times) {
+			const unsigned long due = start
+					+ (unsigned long) (d->replay_times[i] * tsc_ticks_per_ns);
+			while (read_tsc() < due)
+				;
+		}
+		apply_op(d, stream_op(d->stream[i]), stream_key(d->stream[i]));
+	}
+	perf_stop(d->perf);
+#ifdef SCX_STATS
+	if (engine->scx_stats)
+		engine->scx_stats(&d->scx);
+#endif
+#ifdef MEM_STATS
+	if (engine->mem_stats)
+		engine->mem_stats(&d->mem);
+#endif
+	return NULL;
+}
+
+/* inserts a key before the run, keeping it for --record */
+bool prefill_insert(const unsigned long val) {
+	const bool added = engine->insert(val);
+	if (added && record_file)
+		rec_key(&prefill_rec, val);
+	return added;
+}
+
+/* one slice of a parallel prefill */
+typedef struct prefill_job {
+	int id;
+	int nthreads;
+	const unsigned long* keys;  // inserts keys[id], keys[id + nthreads], ...
+	unsigned long nb_keys;
+	unsigned long target;       // or this many random keys, if keys is null,
+	unsigned long lo;           // from (lo, hi]
+	unsigned long hi;
+	volatile unsigned long* added; // keys of all threads, null if uniform
+	unsigned long range;
+	unsigned long seed;
+	unsigned long last;         // last random key added
+	op_record_t rec;
+	mem_stats_t mem;
+} prefill_job_t;
+
+void *prefill_run(void *arg) {
+	prefill_job_t* j = (prefill_job_t*) arg;
+	if (j->keys) {
+		for (unsigned long k = j->id; k < j->nb_keys; k += j->nthreads)
+			if (engine->insert(j->keys[k]) && record_file)
+				rec_key(&j->rec, j->keys[k]);
+	} else {
+		gsl_rng* r = gsl_rng_alloc(gsl_rng_default);
+		gsl_rng_set(r, j->seed);
+		unsigned long added = 0;
+		while (j->added ? *j->added < j->target : added < j->target) {
+			unsigned long val;
+			if (!j->added) {
+				val = j->lo + rand_gsl(r, j->hi - j->lo, UNIFORM);
+			} else {
+				// rejection keeps the shape of the distribution in the slice
+				val = rand_key(r, j->range);
+				if (val <= j->lo || val > j->hi)
+					continue;
+			}
+			if (!engine->insert(val))
+				continue;
+			if (j->added && AO_fetch_and_add_full((AO_t*) j->added, 1)
+					>= j->target) {
+				engine->delete(val); // another thread added the last key
+				break;
+			}
+			if (record_file)
+				rec_key(&j->rec, val);
+			j->last = val;
+			added++;
+		}
+		gsl_rng_free(r);
+	}
+#ifdef MEM_STATS
+	if (engine->mem_stats)
+		engine->mem_stats(&j->mem);
+#endif
+	return NULL;
+}
+
+/*
+ * Populates the set with nthreads threads: either the keys array, strided
+ * across the threads, or target random keys. Thread k adds keys of its
+ * own slice (k * range / nthreads, (k + 1) * range / nthreads] of the key
+ * range, with its own generator seeded with seed + k. Uniform keys are
+ * drawn from the slice directly and every thread adds the slice's share
+ * of target, so the set depends only on the seed and nthreads. Other
+ * distributions draw from the whole range and reject the keys outside
+ * the slice, and the threads stop together once target keys are in, so
+ * each slice gets the share the distribution gives it; which keys make
+ * it in then depends on the timing. Returns the last random key added.
+ */
+unsigned long prefill_parallel(const int nthreads, const unsigned long* keys,
+		const unsigned long nb_keys, const unsigned long target,
+		const unsigned long range, const unsigned long seed, mem_stats_t* mem) {
+	prefill_job_t* jobs = (prefill_job_t*) xmalloc(nthreads * sizeof(prefill_job_t));
+	pthread_t* threads = (pthread_t*) xmalloc(nthreads * sizeof(pthread_t));
+	unsigned long last = -1;
+	volatile unsigned long added = 0;
+	for (int i = 0; i < nthreads; i++) {
+		jobs[i].id = i;
+		jobs[i].nthreads = nthreads;
+		jobs[i].keys = keys;
+		jobs[i].nb_keys = nb_keys;
+		jobs[i].lo = range * i / nthreads;
+		jobs[i].hi = range * (i + 1) / nthreads;
+		jobs[i].added = key_dist == UNIFORM ? NULL : &added;
+		jobs[i].target = key_dist == UNIFORM ? target * jobs[i].hi / range
+				- target * jobs[i].lo / range : target;
+		jobs[i].range = range;
+		jobs[i].seed = seed + i;
+		jobs[i].last = -1;
+		memset(&jobs[i].mem, 0, sizeof(mem_stats_t));
+		if (record_file)
+			rec_init(&jobs[i].rec, keys ? nb_keys / nthreads + 1 : jobs[i].target);
+		if (pthread_create(&threads[i], NULL, prefill_run, &jobs[i]) != 0) {
+			fprintf(stderr, "Error creating prefill thread\n");
+			exit(1);
+		}
+	}
+	for (int i = 0; i < nthreads; i++) {
+		if (pthread_join(threads[i], NULL) != 0) {
+			fprintf(stderr, "Error waiting for prefill thread completion\n");
+			exit(1);
+		}
+		if (jobs[i].last != (unsigned long) -1)
+			last = jobs[i].last;
+		mem_stats_merge(mem, &jobs[i].mem);
+		if (record_file) {
+			for (unsigned long k = 0; k < jobs[i].rec.size; ++k)
+				rec_key(&prefill_rec, jobs[i].rec.ops[k]);
+			rec_free(&jobs[i].rec);
+		}
+	}
+	free(jobs);
+	free(threads);
+	return last;
+}
+
+/* a thread scanning the whole set until the run stops */
+typedef struct scanner {
+	unsigned long scans;
+	unsigned long keys;
+	unsigned long unordered; /* keys not above the one before in a scan */
+	unsigned long seen;      /* keys of the current scan */
+	unsigned long last;
+} scanner_t;
+
+static void scan_visit(const unsigned long key, void* arg) {
+	scanner_t* s = (scanner_t*) arg;
+	if (s->seen++ && key <= s->last)
+		s->unordered++;
+	s->last = key;
+}
+
+void *scan_run(void* arg) {
+	scanner_t* s = (scanner_t*) arg;
+	while (stop == 0) {
+		s->seen = 0;
+		s->keys += engine->scan(0, ULONG_MAX - 1, scan_visit, s);
+		s->scans++;
+	}
+	return NULL;
+}
+
+/* select/rank round trips over the quiescent set, in MODE_RANK */
+void rank_check(const engine_t* e) {
+	const unsigned long keys = e->rank(ULONG_MAX);
+	const int size = e->size();
+	const unsigned long step = keys / 1000 + 1;
+	unsigned long checked = 0, errors = keys != size, key;
+	for (unsigned long i = 0; i < keys; i += step, ++checked)
+		if (!e->select(i, &key) || e->rank(key) != i || !e->get(key))
+			errors++;
+	if (e->select(keys, &key))
+		errors++;
+	printf("rank,keys=%lu,size=%d,checked=%lu,errors=%lu\n", keys, size,
+			checked, errors);
+}
+
+/* one run of engine e with num_of_violation and nb_threads threads */
+void run(const run_config_t* cfg, const engine_t* e, const int num_of_violation,
+		const int nb_threads) {
+	int i, size;
+	unsigned long last = -1;
+	unsigned long val = 0;
+	unsigned long reads, effreads, updates, effupds, ranges, max_retries;
+	thread_data_t *data;
+	pthread_t *threads;
+	pthread_attr_t attr;
+	barrier_t barrier;
+	struct timeval start, end;
+	struct timespec timeout;
+	int duration = cfg->duration;
+	int initial = cfg->initial;
+	unsigned long range = cfg->range;
+	unsigned seed = cfg->seed;
+	int update = cfg->update;
+	int insert_ratio = cfg->insert_ratio;
+	int alternate = cfg->alternate;
+	int effective = cfg->effective;
+	sigset_t block_set;
+
+	timeout.tv_sec = duration / 1000;
+	timeout.tv_nsec = (duration % 1000) * 1000000;
+
+	if (posix_memalign((void**) &data, CACHE_LINE_SIZE,
+			nb_threads * sizeof(thread_data_t)) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+	threads = (pthread_t *) xmalloc(nb_threads * sizeof(pthread_t));
+
+	engine = e;
+	stats_gap_name = e->gap_name ? *e->gap_name : "";
+#ifdef MEM_STATS
+	/* the main thread builds and prefills the set */
+	mem_stats_t main_mem;
+	if (engine->mem_stats)
+		engine->mem_stats(&main_mem);
+#endif
+	if (engine->set_modes)
+		engine->set_modes(modes & engine->modes);
+	if (engine->reserve)
+		engine->reserve(initial, range);
+	engine->init(num_of_violation);
+	stop = 0;
+	warmup_done = 0;
+	const bool warming = warmup > 0 && !presortedness && !replay_file;
+	progress_t* progress = sample_interval > 0 ? progress_alloc(nb_threads) : NULL;
+	if (record_file)
+		rec_init(&prefill_rec, initial);
+
+	i = 0;
+	data[i].first = last;
+	data[i].range = range;
+	data[i].update = update;
+	data[i].insert = insert_ratio;
+	data[i].alternate = alternate;
+	data[i].effective = effective;
+	data[i].nb_add = 0;
+	data[i].nb_added = 0;
+	data[i].nb_remove = 0;
+	data[i].nb_removed = 0;
+	data[i].nb_contains = 0;
+	data[i].nb_found = 0;
+	data[i].nb_range = 0;
+	data[i].nb_range_keys = 0;
+	data[i].barrier = &barrier;
+	data[i].id = i;
+	/* the same prefill for every run */
+	const gsl_rng_type* T;
+	gsl_rng* r;
+	gsl_rng_env_setup();
+	T = gsl_rng_default;
+	r = gsl_rng_alloc(T);
+	gsl_rng_set(r,seed);
+	/* Populate set; the replayed and presorted prefills keep their order */
+	int fill_threads = prefill_threads > 0 ? prefill_threads : nb_threads;
+	if (fill_threads > range)
+		fill_threads = range; // no empty slices of the key range
+	mem_stats_t prefill_mem;
+	memset(&prefill_mem, 0, sizeof(mem_stats_t));
+	struct timeval prefill_start, prefill_end;
+	gettimeofday(&prefill_start, NULL);
+	if (replay_file) {
+		unsigned long prefill_size;
+		const unsigned long* prefill = trace_require(&replay, "prefill", &prefill_size);
+		for (unsigned long j = 0; j < prefill_size; ++j)
+			prefill_insert(prefill[j]);
+	} else if (presortedness) {
+		for (int i = 0; i < p_init_keys_size; ++i) {
+			prefill_insert(p_init_keys[i]);
+		}
+	} else if (key_dist != REAL && fill_threads > 1) {
+		last = prefill_parallel(fill_threads, NULL, 0, initial, range, seed,
+				&prefill_mem);
+	} else if (key_dist != REAL) {
+		/* Populate set */
+		i = 0;
+		while (i < initial) {
+			val = rand_key(r, range);
+			if (prefill_insert(val)) {
+				last = val;
+				i++;
+			}
+		}
+	} else if (fill_threads > 1) {
+		initial = uniq_query_size / 2;
+		prefill_parallel(fill_threads, uniq_query_from_file, initial, 0, range,
+				seed, &prefill_mem);
+	} else {
+		initial = uniq_query_size / 2;
+		for (int i = 0; i < initial; ++i) {
+			prefill_insert(uniq_query_from_file[i]);
+		}
+	}
+	gettimeofday(&prefill_end, NULL);
+	const double prefill_ms = (prefill_end.tv_sec * 1000.0
+			+ prefill_end.tv_usec / 1000.0) - (prefill_start.tv_sec * 1000.0
+			+ prefill_start.tv_usec / 1000.0);
+	printf("prefill,%s%d,%d,%d,%.2f\n", engine->name, num_of_violation,
+			nb_threads, replay_file || presortedness || fill_threads == 1 ? 1 :
+					fill_threads, prefill_ms);
+	size = data[0].nb_added + 2; /// Add 2 for the 2 sentinel keys
+	//size = sl_set_size(set);
+
+	/* Map the operation streams; each thread fills its own slice */
+	unsigned long* streams = NULL;
+	unsigned long stream_len = stream_ops;
+	if (presortedness)
+		stream_len = (p_ops_size + nb_threads - 1) / nb_threads;
+	if (!online && !replay_file && stream_len > 0)
+		streams = stream_map(stream_file, stream_len * nb_threads);
+	op_record_t* recs = NULL;
+	if (record_file)
+		recs = (op_record_t*) xmalloc(nb_threads * sizeof(op_record_t));
+
+	/* The sampler counts keys from here on without reading the set */
+	const long sampler_keys = progress ? engine->size() : 0;
+
+	/* Access set from all threads */
+	barrier_init(&barrier, nb_threads + 1);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	for (i = 0; i < nb_threads; i++) {
+		data[i].first = last;
+		data[i].range = range;
+		data[i].update = update;
+		data[i].insert = insert_ratio;
+		data[i].alternate = alternate;
+		data[i].effective = effective;
+		data[i].nb_add = 0;
+		data[i].nb_added = 0;
+		data[i].nb_remove = 0;
+		data[i].nb_removed = 0;
+		data[i].nb_contains = 0;
+		data[i].nb_found = 0;
+		data[i].nb_range = 0;
+		data[i].nb_range_keys = 0;
+		data[i].barrier = &barrier;
+		data[i].id = i;
+		data[i].seed = seed + i;
+		data[i].numThreads = nb_threads;
+		memset(&data[i].scx, 0, sizeof(scx_stats_t));
+		memset(&data[i].mem, 0, sizeof(mem_stats_t));
+		data[i].stream = streams ? streams + i * stream_len : NULL;
+		data[i].stream_len = stream_len;
+		data[i].lat = NULL;
+		data[i].rec = NULL;
+		data[i].replay_times = NULL;
+		data[i].perf = NULL;
+		data[i].progress = progress ? &progress[i] : NULL;
+		data[i].warming = warming;
+		if (perf_mode != PERF_OFF)
+			data[i].perf = (perf_counters_t*) xmalloc(sizeof(perf_counters_t));
+		data[i].interval = target_rate ?
+				(unsigned long) (tsc_ticks_per_ns * 1e9 * nb_threads / target_rate) : 0;
+		if (record_file) {
+			data[i].rec = &recs[i];
+			rec_init(data[i].rec, online ? DEFAULT_STREAM_OPS : stream_len);
+		}
+		if (replay_file) {
+			char name[TRACE_NAME_LEN];
+			snprintf(name, sizeof(name), "thread%d/ops", i);
+			data[i].stream = trace_require(&replay, name, &data[i].stream_len);
+			if (replay_rate) {
+				unsigned long times_len;
+				snprintf(name, sizeof(name), "thread%d/time", i);
+				data[i].replay_times = trace_require(&replay, name, &times_len);
+			}
+		}
+		if (latency_period) {
+			data[i].lat = (latency_t*) xmalloc(sizeof(latency_t));
+			lat_init(data[i].lat, latency_period);
+		}
+		if (replay_file) {
+			if (pthread_create(&threads[i], &attr, r_test, (void*) (&data[i]))
+					!= 0) {
+				perror("error creating thread");
+				exit(1);
+			}
+		} else if (presortedness) {
+			if (pthread_create(&threads[i], &attr, p_test, (void*)(&data[i]))
+					!= 0) {
+				perror("error creating thread");
+				exit(1);
+			}
+		} else {
+			if (pthread_create(&threads[i], &attr, test, (void *) (&data[i]))
+					!= 0) {
+				perror("error creating thread");
+				exit(1);
+			}
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	/* Start threads */
+	barrier_cross(&barrier);
+
+	sampler_t sampler;
+	if (progress) {
+		sampler.progress = progress;
+		sampler.nthreads = nb_threads;
+		sampler.interval = sample_interval;
+		sampler.height = sample_height ? engine->height : NULL;
+		sampler.keys = sampler_keys;
+		sampler.warmup_done = warming ? &warmup_done : NULL;
+		sampler.f = stdout;
+		snprintf(sampler.label, sizeof(sampler.label), "%s%d/%d", engine->name,
+				num_of_violation, nb_threads);
+		sampler_start(&sampler);
+	}
+	if (warming) {
+		struct timespec pause = { warmup / 1000, (warmup % 1000) * 1000000 };
+		nanosleep(&pause, NULL);
+		AO_store_full(&warmup_done, 1);
+	}
+	gettimeofday(&start, NULL);
+	/* scanners run beside the timed random workloads only */
+	const int nb_scanners = engine->scan && !presortedness && !replay_file ?
+			scanners : 0;
+	pthread_t* scan_threads = NULL;
+	scanner_t* scans = NULL;
+	if (nb_scanners > 0) {
+		scan_threads = (pthread_t*) xmalloc(nb_scanners * sizeof(pthread_t));
+		scans = (scanner_t*) xmalloc(nb_scanners * sizeof(scanner_t));
+		memset(scans, 0, nb_scanners * sizeof(scanner_t));
+		for (i = 0; i < nb_scanners; i++) {
+			if (pthread_create(&scan_threads[i], NULL, scan_run, &scans[i])
+					!= 0) {
+				perror("error creating thread");
+				exit(1);
+			}
+		}
+	}
+	if (!presortedness && !replay_file) {
+	if (duration > 0) {
+		if (shape_interval > 0 && engine->tree_stats)
+			stats_series(stdout, duration, shape_interval,
+					shape_threads > 0 ? shape_threads : 1);
+		else
+			nanosleep(&timeout, NULL);
+	} else {
+		sigemptyset(&block_set);
+		sigsuspend(&block_set);
+	}
+	}
+#ifdef ICC
+	stop = 1;
+#else
+	AO_store_full(&stop, 1);
+#endif /* ICC */
+
+
+
+	/* Wait for thread completion */
+	for (i = 0; i < nb_threads; i++) {
+		if (pthread_join(threads[i], NULL) != 0) {
+			perror("Error waiting for thread completion\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < nb_scanners; i++) {
+		if (pthread_join(scan_threads[i], NULL) != 0) {
+			perror("Error waiting for thread completion\n");
+			exit(1);
+		}
+	}
+	gettimeofday(&end, NULL);
+	if (progress) {
+		sampler_stop(&sampler);
+		free(progress);
+	}
+
+	duration = (end.tv_sec * 1000 + end.tv_usec / 1000)
+			- (start.tv_sec * 1000 + start.tv_usec / 1000);
+	double p_duration = 0;
+	if (presortedness || replay_file) {
+		p_duration = (double)end.tv_sec * 1000 -
+				(double)start.tv_sec * 1000 +
+				(double)end.tv_usec / 1000 -
+				(double)start.tv_usec / 1000;
+	}
+	reads = 0;
+	effreads = 0;
+	updates = 0;
+	effupds = 0;
+	ranges = 0;
+	max_retries = 0;
+	for (i = 0; i < nb_threads; i++) {
+		reads += data[i].nb_contains;
+		effreads += data[i].nb_contains + (data[i].nb_add - data[i].nb_added)
+				+ (data[i].nb_remove - data[i].nb_removed);
+		/* range deletes count as one op each in the throughput; they stay
+		 * out of the per-key effective counts and go on the range line */
+		updates += data[i].nb_add + data[i].nb_remove + data[i].nb_range;
+		ranges += data[i].nb_range;
+		effupds += data[i].nb_removed + data[i].nb_added;
+		size += data[i].nb_added - data[i].nb_removed - data[i].nb_range_keys;
+
+	}
+//	print_tree();
+	end:
+	if (presortedness || replay_file) {
+		printf("%s%d,%s,%ld,%.2f,%.2f,%d,%.2f,%.2f,%.2f,%d",
+				engine->name, num_of_violation, replay_file ? replay_file : presortedness_file_name, range,
+			(double) update / 100,
+			(double) insert_ratio / 100 * (double) update / 100, nb_threads,
+			(double) effupds / (double) (updates - ranges), p_duration,
+			(reads + updates) * 1000.0 / p_duration, engine->height());
+	} else {
+		printf("%s%d,%ld,%d,%.2f,%.2f,%d,(%d %.2f),%.2f,%d",
+				engine->name, num_of_violation, range, initial,
+			(double)update / 100, (double)insert_ratio / 100 *
+			(double)update / 100, nb_threads, key_dist, (double) effupds / (double) (updates - ranges),
+			(reads + updates) * 1000.0 / duration, engine->height());
+	}
+	if (json_out) {
+		const double elapsed = presortedness || replay_file ? p_duration : duration;
+		fprintf(json_out, "{\"engine\":\"%s\",\"d\":%d,\"threads\":%d,"
+				"\"workload\":\"%s\",\"range\":%lu,\"initial\":%d,"
+				"\"update\":%.2f,\"insert\":%.2f,\"key_dist\":%d,\"alpha\":%.2f,"
+				"\"duration_ms\":%.2f,\"ops\":%lu,\"throughput\":%.2f,"
+				"\"effective_update\":%.4f,\"height\":%d,\"size\":%d,"
+				"\"prefill_ms\":%.2f,\"modes\":%d}\n",
+				engine->name, num_of_violation, nb_threads,
+				replay_file ? "replay" : presortedness ? "presortedness" :
+						key_dist == REAL ? "real" : "random", range, initial,
+				(double) update / 100,
+				(double) insert_ratio / 100 * (double) update / 100, key_dist,
+				alpha, elapsed, reads + updates,
+				(reads + updates) * 1000.0 / elapsed,
+				updates > ranges ? (double) effupds / (updates - ranges) : 0, engine->height(),
+				engine->size(), prefill_ms, modes & engine->modes);
+		fflush(json_out);
+	}
+	if (target_rate)
+		printf(",%lu", target_rate);
+	if (perf_mode != PERF_OFF) {
+		perf_counters_t perf_total = *data[0].perf;
+		for (i = 1; i < nb_threads; i++)
+			perf_merge(&perf_total, data[i].perf);
+		for (i = 0; i < nb_threads; i++)
+			free(data[i].perf);
+		perf_print_csv(stdout, &perf_total, reads + updates);
+	}
+	if (latency_period) {
+		latency_t* merged = (latency_t*) xmalloc(sizeof(latency_t));
+		lat_init(merged, latency_period);
+		for (i = 0; i < nb_threads; i++) {
+			lat_merge(merged, data[i].lat);
+			free(data[i].lat);
+		}
+		const double ticks_per_ns = lat_calibrate();
+		lat_print_csv(stdout, merged, ticks_per_ns);
+		printf("\n");
+		/* one object per run, in the order of the CSV lines */
+		static int latency_runs = 0;
+		FILE* json = latency_json ?
+				fopen(latency_json, latency_runs++ ? "a" : "w") : stderr;
+		if (!json) {
+			perror("latency-json");
+		} else {
+			lat_print_json(json, merged, ticks_per_ns);
+			if (json != stderr)
+				fclose(json);
+		}
+		free(merged);
+	} else {
+		printf("\n");
+	}
+#ifdef SCX_STATS
+	if (engine->scx_stats) {
+		scx_stats_t scx_total;
+		memset(&scx_total, 0, sizeof(scx_stats_t));
+		for (i = 0; i < nb_threads; i++)
+			scx_stats_merge(&scx_total, &data[i].scx);
+		scx_stats_print(stdout, &scx_total, reads + updates,
+				engine->rebalance_names);
+	}
+#endif
+	if (engine->footprint) {
+		mem_footprint_t footprint;
+		engine->footprint(&footprint);
+		const mem_stats_t* counted = NULL;
+#ifdef MEM_STATS
+		mem_stats_t mem_total;
+		if (engine->mem_stats) {
+			engine->mem_stats(&mem_total);
+			mem_stats_sub(&mem_total, &main_mem);
+			mem_stats_merge(&mem_total, &prefill_mem);
+			for (i = 0; i < nb_threads; i++)
+				mem_stats_merge(&mem_total, &data[i].mem);
+			counted = &mem_total;
+		}
+#endif
+		mem_print(stdout, &footprint, counted, engine->size(), rss_kb());
+	}
+	if ((modes & engine->modes & MODE_RANK) && engine->rank)
+		rank_check(engine);
+	if (range_width && engine->delete_range) {
+		unsigned long calls = 0, keys = 0;
+		for (i = 0; i < nb_threads; i++) {
+			calls += data[i].nb_range;
+			keys += data[i].nb_range_keys;
+		}
+		printf("range,%s%d,%d,width=%lu,calls=%lu,keys=%lu,keys_per_call=%.2f,"
+				"keys_per_s=%.0f\n", engine->name, num_of_violation, nb_threads,
+				range_width, calls, keys, calls ? (double) keys / calls : 0,
+				keys * 1000.0 / duration);
+	}
+	if (nb_scanners > 0) {
+		scanner_t total;
+		memset(&total, 0, sizeof(scanner_t));
+		for (i = 0; i < nb_scanners; i++) {
+			total.scans += scans[i].scans;
+			total.keys += scans[i].keys;
+			total.unordered += scans[i].unordered;
+		}
+		printf("scan,%s%d,%d,scanners=%d,snapshot=%d,scans=%lu,keys=%lu,"
+				"scans_per_s=%.2f,keys_per_s=%.0f,unordered=%lu\n",
+				engine->name, num_of_violation, nb_threads, nb_scanners,
+				(modes & engine->modes & MODE_SNAPSHOT) != 0, total.scans,
+				total.keys, total.scans * 1000.0 / duration,
+				total.keys * 1000.0 / duration, total.unordered);
+		free(scans);
+		free(scan_threads);
+	}
+	if (shape_threads > 0 && engine->tree_stats) {
+		tree_stats_t* shape = (tree_stats_t*) xmalloc(sizeof(tree_stats_t));
+		stats_clear(shape);
+		tree_stats(shape, shape_threads);
+		stats_print(stdout, "end", shape);
+		free(shape);
+	}
+	/* Delete set */
+	//sl_set_delete(set);
+
+	if (record_file) {
+		rec_write(record_file, recs, nb_threads, &prefill_rec, lat_calibrate());
+		for (i = 0; i < nb_threads; i++)
+			rec_free(&recs[i]);
+		rec_free(&prefill_rec);
+		free(recs);
+	}
+	if (streams)
+		stream_unmap(streams, stream_len * nb_threads);
+	gsl_rng_free(r);
+	free(threads);
+	free(data);
+}
+
+int main(int argc, char **argv) {
+	struct option long_options[] = {
+	// These options don't set a flag
+			{ "help", no_argument, NULL, 'h' }, { "duration", required_argument,
+			NULL, 'd' }, { "initial-size", required_argument, NULL, 'i' }, {
+					"thread-num",
+					required_argument, NULL, 't' }, { "range",
+			required_argument, NULL, 'r' }, { "seed", required_argument,
+			NULL, 'S' }, { "update-rate", required_argument, NULL, 'u' }, {
+					"unit-tx",
+					required_argument, NULL, 'x' },
+					{ "zipf", required_argument, NULL, 'Z' },
+					{ "real", required_argument, NULL, 'R' },
+					{ "presortedness", required_argument, NULL, 'p' },
+					{ "duplicate", required_argument, NULL, 'D' },
+					{ "violations", required_argument, NULL, 'v' },
+					{ "latency", required_argument, NULL, 'L' },
+					{ "latency-json", required_argument, NULL, 'J' },
+					{ "shape-threads", required_argument, NULL, 'P' },
+					{ "shape-interval", required_argument, NULL, 'T' },
+					{ "online", no_argument, NULL, 'O' },
+					{ "stream-ops", required_argument, NULL, 'N' },
+					{ "stream-file", required_argument, NULL, 'M' },
+					{ "zipf-ri", required_argument, NULL, 'z' },
+					{ "zipf-scrambled", required_argument, NULL, 'Y' },
+					{ "sampler-bench", required_argument, NULL, 'B' },
+					{ "trace-file", required_argument, NULL, 'F' },
+					{ "convert", required_argument, NULL, 'C' },
+					{ "record", required_argument, NULL, 'W' },
+					{ "replay", required_argument, NULL, 'X' },
+					{ "replay-rate", no_argument, NULL, 'K' },
+					{ "rate", required_argument, NULL, 'Q' },
+					{ "perf", no_argument, NULL, 'H' },
+					{ "engine", required_argument, NULL, 'e' },
+					{ "json", required_argument, NULL, 'j' },
+					{ "sample-interval", required_argument, NULL, 'I' },
+					{ "sample-height", no_argument, NULL, OPT_SAMPLE_HEIGHT },
+					{ "warmup", required_argument, NULL, 'w' },
+					{ "self-check", no_argument, NULL, 'c' },
+					{ "prefill-threads", required_argument, NULL, 'y' },
+					{ "finger", no_argument, NULL, 'g' },
+					{ "append", no_argument, NULL, 'a' },
+					{ "elimination", no_argument, NULL, 'k' },
+					{ "combine", no_argument, NULL, 'b' },
+					{ "backoff", no_argument, NULL, 'o' },
+					{ "lazy-help", no_argument, NULL, 'l' },
+					{ "cache", no_argument, NULL, 'q' },
+					{ "bloom", no_argument, NULL, 'n' },
+					{ "rank", required_argument, NULL, 'm' },
+					{ "exact-size", no_argument, NULL, 's' },
+					{ "snapshot", required_argument, NULL, 'V' },
+					{ "delete-range", required_argument, NULL, 'U' },
+					{ NULL, 0, NULL, 0 } };
+
+	int i, c;
+	run_config_t cfg = { DEFAULT_DURATION, DEFAULT_INITIAL, DEFAULT_RANGE,
+			DEFAULT_SEED, DEFAULT_UPDATE, DEFAULT_INSERT_RATIO, DEFAULT_ALTERNATE,
+			DEFAULT_EFFECTIVE };
+	int unit_tx = DEFAULT_ELASTICITY;
+
+	while (1) {
+		i = 0;
+		c = getopt_long(argc, argv, "hAEGOKHcgakbolqnsm:V:U:y:f:d:i:t:r:S:u:x:Z:R:p:D:v:L:J:P:T:N:M:z:Y:B:F:C:W:X:Q:e:j:I:w:", long_options, &i);
+		if (c == -1)
+			break;
+
+		if (c == 0 && long_options[i].flag == 0)
+			c = long_options[i].val;
+
+		switch (c) {
+		case 0:
+			/* Flag is automatically set */
+			break;
+		case 'p':
+			presortedness = 1;
+			strcpy(presortedness_file_name, optarg);
+			break;
+		case 'D':
+			p_dup = 1;
+			break;
+		case 'G':
+			key_dist = GAUSSIAN;
+			break;
+		case 'Z':
+			key_dist = ZIPF;
+			alpha = atof(optarg);
+			break;
+		case 'R':
+			key_dist = REAL;
+			real_file = atoi(optarg);
+			break;
+		case 'v':
+			nb_violations = parse_list(optarg, violations);
+			break;
+		case 'e':
+			for (char* tok = strtok(optarg, ","); tok && nb_engines < MAX_SWEEP;
+					tok = strtok(NULL, ","))
+				engines[nb_engines++] = find_engine(tok);
+			break;
+		case 'j':
+			json_file = optarg;
+			break;
+		case 'I':
+			sample_interval = atoi(optarg);
+			break;
+		case OPT_SAMPLE_HEIGHT:
+			sample_height = 1;
+			break;
+		case 'w':
+			warmup = atoi(optarg);
+			break;
+		case 'c':
+			self_check = 1;
+			break;
+		case 'y':
+			prefill_threads = atoi(optarg);
+			break;
+		case 'g':
+			modes |= MODE_FINGER;
+			break;
+		case 'a':
+			modes |= MODE_APPEND;
+			break;
+		case 'k':
+			modes |= MODE_ELIM;
+			break;
+		case 'b':
+			modes |= MODE_COMBINE;
+			break;
+		case 'o':
+			modes |= MODE_BACKOFF;
+			break;
+		case 'l':
+			modes |= MODE_LAZY_HELP;
+			break;
+		case 'q':
+			modes |= MODE_CACHE;
+			break;
+		case 'n':
+			modes |= MODE_BLOOM;
+			break;
+		case 'm':
+			modes |= MODE_RANK;
+			rank_reads = atoi(optarg);
+			break;
+		case 's':
+			modes |= MODE_SIZE;
+			break;
+		case 'V':
+			modes |= MODE_SNAPSHOT;
+			scanners = atoi(optarg);
+			break;
+		case 'U':
+			range_width = atol(optarg);
+			break;
+		case 'L':
+			latency_period = atol(optarg);
+			break;
+		case 'J':
+			latency_json = optarg;
+			break;
+		case 'P':
+			shape_threads = atoi(optarg);
+			break;
+		case 'T':
+			shape_interval = atoi(optarg);
+			break;
+		case 'O':
+			online = 1;
+			break;
+		case 'N':
+			stream_ops = atol(optarg);
+			break;
+		case 'M':
+			stream_file = optarg;
+			break;
+		case 'z':
+			key_dist = ZIPF_RI;
+			alpha = atof(optarg);
+			break;
+		case 'Y':
+			key_dist = ZIPF_SCRAMBLED;
+			alpha = atof(optarg);
+			break;
+		case 'B':
+			sampler_bench = atol(optarg);
+			break;
+		case 'F':
+			trace_file = optarg;
+			break;
+		case 'C':
+			convert_file = optarg;
+			break;
+		case 'W':
+			record_file = optarg;
+			break;
+		case 'X':
+			replay_file = optarg;
+			break;
+		case 'K':
+			replay_rate = 1;
+			break;
+		case 'Q':
+			target_rate = atol(optarg);
+			break;
+		case 'H':
+			perf_mode = PERF_HW;
+			break;
+		case 'h':
+			printf(
+					"Lock-Free BST benchmark "
+							"\n"
+							"Usage:\n"
+							"  intset [options...]\n"
+							"\n"
+							"Options:\n"
+							"  -h, --help\n"
+							"        Print this message\n"
+							"  -A, --Alternate\n"
+							"        Consecutive insert/remove target the same value\n"
+							"  -f, --effective <int>\n"
+							"        update txs must effectively write (0=trial, 1=effective, default=" XSTR(DEFAULT_EFFECTIVE) ")\n"
+					"  -d, --duration <int>\n"
+					"        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+					"  -i, --initial-size <int>\n"
+					"        Number of elements to insert before test (default=" XSTR(DEFAULT_INITIAL) ")\n"
+					"  -e, --engine <name[,name...]>\n"
+					"        Sets to run: dwrbavl, chromatic, rbtree (mutex), skiplist (lock-free),\n"
+					"        empty (operations return at once: the harness overhead ceiling)\n"
+					"        (default=" DEFAULT_ENGINE ")\n"
+					"  -v, --violations <int[,int...]>\n"
+					"        Violations d allowed per path, one run each (default=0)\n"
+					"  -t, --thread-num <int[,int...]>\n"
+					"        Number of threads, one run each (default=" XSTR(DEFAULT_NB_THREADS) ")\n"
+					"  -r, --range <int>\n"
+					"        Range of integer values inserted in set (default=" XSTR(DEFAULT_RANGE) ")\n"
+					"  -S, --seed <int>\n"
+					"        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
+					"  -u, --update-rate <int>\n"
+					"        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+					"  -x, --unit-tx (default=1)\n"
+					"        Use unit transactions\n"
+					"        0 = non-protected,\n"
+					"        1 = normal transaction,\n"
+					"        2 = read unit-tx,\n"
+					"        3 = read/add unit-tx,\n"
+					"        4 = read/add/rem unit-tx,\n"
+					"        5 = all recursive unit-tx,\n"
+					"        6 = harris lock-free\n"
+					"  -L, --latency <int>\n"
+					"        Record the latency of one in every <int> operations (0=off, default=0);\n"
+					"        the fix_to_key row needs trees built with make FIX_TIMING=1\n"
+					"  -J, --latency-json <file>\n"
+					"        Write the merged latency report as JSON to <file> (default=stderr)\n"
+					"  -P, --shape-threads <int>\n"
+					"        Print a tree shape report after the run using <int> threads (0=off, default=0)\n"
+					"  -T, --shape-interval <int>\n"
+					"        Print a tree shape sample every <int> milliseconds during the run (0=off, default=0)\n"
+					"  -O, --online\n"
+					"        Generate operations inside the timed loop instead of pre-generating streams\n"
+					"  -N, --stream-ops <int>\n"
+					"        Pre-generated operations per thread, replayed cyclically (default=" XSTR(DEFAULT_STREAM_OPS) ")\n"
+					"  -M, --stream-file <file>\n"
+					"        Back the operation streams with a shared mapping of <file>\n"
+					"  -z, --zipf-ri <double>\n"
+					"        Zipf keys with exponent <double>, constant-memory rejection-inversion sampler\n"
+					"  -Y, --zipf-scrambled <double>\n"
+					"        As -z, with ranks hashed over the key range\n"
+					"  -B, --sampler-bench <int>\n"
+					"        Time Zipf sampler setup and <int> samples for -r and -Z/-z alpha, then exit\n"
+					"  -F, --trace-file <file>\n"
+					"        Map the -R/-p data from a binary trace file instead of parsing text\n"
+					"  -C, --convert <file>\n"
+					"        Add the -R/-p data to the binary trace file <file>, then exit\n"
+					"  -W, --record <file>\n"
+					"        Write the prefill keys and each thread's timed operations to <file>\n"
+					"  -X, --replay <file>\n"
+					"        Prefill and run the operations recorded in <file>, one thread per recorded thread\n"
+					"  -K, --replay-rate\n"
+					"        Issue replayed operations at their recorded times instead of at full speed\n"
+					"  -Q, --rate <int>\n"
+					"        Open loop: issue <int> ops/sec over all threads on a fixed schedule and time\n"
+					"        each operation from its scheduled start (0=closed loop, default=0)\n"
+					"  -H, --perf\n"
+					"        Report per-operation hardware counters (software counters if the PMU is unavailable)\n"
+					"  -j, --json <file>\n"
+					"        Also write each run as one JSON object per line to <file>\n"
+					"  -I, --sample-interval <int>\n"
+					"        Print throughput, height, RSS and RSS per key every <int> milliseconds\n"
+					"        (0=off, default=0)\n"
+					"      --sample-height\n"
+					"        Walk the tree for the height of every sample (printed as 0 otherwise)\n"
+					"  -w, --warmup <int>\n"
+					"        Run <int> milliseconds before the measured duration, excluded from the\n"
+					"        summary, latency and perf counters (random workloads only, default=0)\n"
+					"  -c, --self-check\n"
+					"        Run the empty set first at every thread count\n"
+					"  -y, --prefill-threads <int>\n"
+					"        Threads that populate the set before each run, 0 for one per benchmark\n"
+					"        thread; each draws its random keys from its own slice of the range,\n"
+					"        so the set depends on the seed and the thread count (replayed and\n"
+					"        presorted prefills stay sequential, default=1)\n"
+					"  -g, --finger\n"
+					"        Start each search from the thread's last path (dwrbavl, chromatic)\n"
+					"  -a, --append\n"
+					"        Insert keys past the maximum straight at the right spine and repair\n"
+					"        the spine once per 16 such inserts of a thread (dwrbavl, chromatic)\n"
+					"  -k, --elimination\n"
+					"        Let concurrent insert/delete pairs on a key cancel out without\n"
+					"        touching the tree (dwrbavl, chromatic)\n"
+					"  -b, --combine\n"
+					"        Threads whose updates keep conflicting hand them to a combiner that\n"
+					"        applies them in key order, one SCX each, for each of 16 slices of\n"
+					"        the key range; the others wait for it (dwrbavl, chromatic)\n"
+					"  -o, --backoff\n"
+					"        Wait a random number of spins after a failed update attempt, within a\n"
+					"        per-thread window that doubles on failure and halves on success\n"
+					"        (dwrbavl, chromatic)\n"
+					"  -l, --lazy-help\n"
+					"        Give the owner of an in-progress SCX a few spins to finish before\n"
+					"        helping it, adapted per thread (dwrbavl, chromatic)\n"
+					"  -q, --cache\n"
+					"        Answer get from a direct-mapped cache of the leaves recent searches\n"
+					"        ended at, for skewed workloads (dwrbavl, chromatic)\n"
+					"  -n, --bloom\n"
+					"        Answer get for absent keys from a counting Bloom filter sized for the\n"
+					"        initial number of keys (dwrbavl, chromatic)\n"
+					"  -m, --rank <int>\n"
+					"        Keep subtree key counts up to date and issue <int> percent of the\n"
+					"        reads as rank queries; rank/select are checked after the run\n"
+					"        (dwrbavl, chromatic built with make RANK_COUNTS=1)\n"
+					"  -s, --exact-size\n"
+					"        Make size() linearizable: it holds off updates while it sums the\n"
+					"        per-thread key counts (dwrbavl, chromatic; otherwise size() may\n"
+					"        miss the updates in progress)\n"
+					"  -V, --snapshot <int>\n"
+					"        Keep the nodes updates replace so that scans see the set of one\n"
+					"        instant, and run <int> more threads that scan the whole set during\n"
+					"        the run (random workloads; dwrbavl, chromatic built with\n"
+					"        make SNAPSHOT_VERSIONS=1)\n"
+					"  -U, --delete-range <int>\n"
+					"        Each delete removes the <int> key values from its key on with one\n"
+					"        delete_range, which unlinks whole subtrees (dwrbavl, chromatic;\n"
+					"        0=off, default=0)\n");
+			exit(0);
+		case 'A':
+			cfg.alternate = 1;
+			break;
+		case 'E':
+			cfg.effective = 1;
+			break;
+		case 'f':
+			cfg.insert_ratio = atoi(optarg);
+			//effective = atoi(optarg);
+			break;
+		case 'd':
+			cfg.duration = atoi(optarg);
+			break;
+		case 'i':
+			cfg.initial = atoi(optarg);
+			break;
+		case 't':
+			nb_thread_counts = parse_list(optarg, thread_counts);
+			break;
+		case 'r':
+			cfg.range = atol(optarg);
+			break;
+		case 'S':
+			cfg.seed = atoi(optarg);
+			break;
+		case 'u':
+			cfg.update = atoi(optarg);
+			break;
+		case 'x':
+			unit_tx = atoi(optarg);
+			break;
+		case '?':
+			printf("Use -h or --help for help\n");
+			exit(0);
+		default:
+			exit(1);
+		}
+	}
+
+	if (nb_engines == 0)
+		engines[nb_engines++] = find_engine(DEFAULT_ENGINE);
+	assert(cfg.duration >= 0);
+	assert(cfg.initial >= 0);
+	for (i = 0; i < nb_thread_counts; i++)
+		assert(thread_counts[i] > 0);
+	assert(cfg.range > 0 && cfg.range >= cfg.initial);
+	assert(cfg.update >= 0 && cfg.update <= 100);
+
+	if (replay_file) {
+		if (!trace_open(&replay, replay_file))
+			exit(1);
+		thread_counts[0] = replay_threads(&replay);
+		nb_thread_counts = 1;
+		if (thread_counts[0] == 0) {
+			fprintf(stderr, "%s: no recorded threads\n", replay_file);
+			exit(1);
+		}
+	}
+	if (perf_mode != PERF_OFF)
+		perf_mode = perf_probe();
+
+	const gsl_rng_type* T;
+	gsl_rng* r;
+	gsl_rng_env_setup();
+	T = gsl_rng_default;
+	r = gsl_rng_alloc(T);
+	gsl_rng_set(r, cfg.seed);
+
+	if (trace_file && !trace_open(&trace, trace_file))
+		exit(1);
+
+	if (sampler_bench) {
+		zipf_benchmark(r, cfg.range, alpha, sampler_bench);
+		exit(0);
+	}
+
+	if (key_dist == ZIPF) {
+		initZipf(r, cfg.range, alpha);
+	} else if (key_dist == ZIPF_RI || key_dist == ZIPF_SCRAMBLED) {
+		zipf_init(&zipf, cfg.range, alpha);
+	} else if (key_dist == REAL) {
+		if (trace_file) {
+			char name[TRACE_NAME_LEN];
+			snprintf(name, sizeof(name), "real%d/query", real_file);
+			query_from_file = trace_require(&trace, name, &query_size);
+			snprintf(name, sizeof(name), "real%d/uniq_query", real_file);
+			uniq_query_from_file = trace_require(&trace, name, &uniq_query_size);
+		} else {
+			load_query_from_file(real_file, &query_from_file, &query_size,
+					&uniq_query_from_file, &uniq_query_size, cfg.alternate);
+		}
+	} else if (presortedness) {
+		if (trace_file) {
+			char name[TRACE_NAME_LEN];
+			snprintf(name, sizeof(name), "%s/p_ops", presortedness_file_name);
+			p_ops = trace_require(&trace, name, &p_ops_size);
+			snprintf(name, sizeof(name), "%s/p_init_keys", presortedness_file_name);
+			p_init_keys = trace_require(&trace, name, &p_init_keys_size);
+		} else {
+			load_presortedness_from_file(presortedness_file_name, &p_ops, &p_ops_size, &p_init_keys, &p_init_keys_size);
+		}
+	}
+
+	if (convert_file) {
+		char names[2][TRACE_NAME_LEN];
+		trace_input_t in[2];
+		if (key_dist == REAL) {
+			snprintf(names[0], TRACE_NAME_LEN, "real%d/query", real_file);
+			snprintf(names[1], TRACE_NAME_LEN, "real%d/uniq_query", real_file);
+			trace_input_t q = { names[0], TRACE_KEYS, query_from_file, query_size };
+			trace_input_t u = { names[1], TRACE_KEYS, uniq_query_from_file, uniq_query_size };
+			in[0] = q;
+			in[1] = u;
+		} else if (presortedness) {
+			snprintf(names[0], TRACE_NAME_LEN, "%s/p_ops", presortedness_file_name);
+			snprintf(names[1], TRACE_NAME_LEN, "%s/p_init_keys", presortedness_file_name);
+			trace_input_t o = { names[0], TRACE_KEYS, p_ops, p_ops_size };
+			trace_input_t k = { names[1], TRACE_KEYS, p_init_keys, p_init_keys_size };
+			in[0] = o;
+			in[1] = k;
+		} else {
+			fprintf(stderr, "--convert needs -R or -p\n");
+			exit(1);
+		}
+		trace_write(convert_file, in, 2);
+		printf("trace,%s,%s=%lu,%s=%lu\n", convert_file, names[0], in[0].count,
+				names[1], in[1].count);
+		exit(0);
+	}
+
+	if (json_file && !(json_out = fopen(json_file, "w"))) {
+		perror(json_file);
+		exit(1);
+	}
+	if (replay_rate || target_rate)
+		tsc_ticks_per_ns = lat_calibrate();
+	/* open-loop latency is only meaningful per operation: sample them all */
+	if (target_rate && !latency_period)
+		latency_period = 1;
+
+	/* the empty set never grows, so it runs without a prefill */
+	run_config_t check = cfg;
+	check.initial = 0;
+	if (self_check)
+		for (int t = 0; t < nb_thread_counts; t++)
+			run(&check, &empty_engine, 0, thread_counts[t]);
+	for (int e = 0; e < nb_engines; e++) {
+		/* sets without violations run once, reported as d = 0 */
+		const int nb_d = engines[e]->violations ? nb_violations : 1;
+		const run_config_t* c = engines[e] == &empty_engine ? &check : &cfg;
+		for (int v = 0; v < nb_d; v++)
+			for (int t = 0; t < nb_thread_counts; t++)
+				run(c, engines[e], engines[e]->violations ? violations[v] : 0,
+						thread_counts[t]);
+	}
+	gsl_rng_free(r);
+	if (trace_file)
+		trace_close(&trace);
+	if (replay_file)
+		trace_close(&replay);
+	if (json_out)
+		fclose(json_out);
+#ifndef TLS
+	pthread_key_delete(rng_seed_key);
+#endif /* ! TLS */
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * bench.h
+ *
+ *  Thread state of the benchmark driver. Every worker's block is cache
+ *  line aligned, so the counters it bumps on each operation never share
+ *  a line with another worker's.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <jemalloc/jemalloc.h>
+#include "../scx_stats.h"
+#include "../mem_stats.h"
+#include "../sampler.h"
+
+#define true 					1
+#define false 					0
+
+#define null					0
+
+#define SUCCESS 				0
+
+typedef struct barrier {
+	pthread_cond_t complete;
+	pthread_mutex_t mutex;
+	int count;
+	int crossing;
+} barrier_t;
+
+typedef struct thread_data {
+  unsigned long first;
+  unsigned long range;
+  int update;
+  int insert;
+  int alternate;
+  int effective;
+  int id;
+  unsigned long numThreads;
+  unsigned long nb_add;
+  unsigned long nb_added;
+  unsigned long nb_remove;
+  unsigned long nb_removed;
+  unsigned long nb_contains;
+  unsigned long nb_found;
+  unsigned long nb_range; /* delete_range calls, not in nb_remove */
+  unsigned long nb_range_keys; /* keys removed by delete_range */
+  unsigned long ops;
+  unsigned int seed;
+  double search_frac;
+  double insert_frac;
+  double delete_frac;
+  unsigned long keyspace1_size;
+  barrier_t *barrier;
+  unsigned long *stream;
+  unsigned long stream_len;
+  struct latency *lat;
+  scx_stats_t scx;
+  mem_stats_t mem;
+  struct op_record *rec;
+  const unsigned long *replay_times;
+  unsigned long interval;
+  unsigned long intended;
+  struct perf_counters *perf;
+  unsigned long *fix_ticks;
+  struct progress *progress;
+  int warming;
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_data_t;
+
+// also the out-of-line definition for the trees' inline xmalloc
+void *xmalloc(size_t size);
+
+#endif /* BENCH_H_ */
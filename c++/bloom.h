@@ -0,0 +1,115 @@
+/*
+ * bloom.h
+ *
+ *  Blocked counting Bloom filter in front of get. A key maps to one
+ *  64-byte block of 128 4-bit counters and to BLOOM_HASHES counters in
+ *  it, so a lookup reads a single cache line. insert counts its key
+ *  before the key can appear in the tree and takes it back if the key was
+ *  already there; delete uncounts it after the key left. While a key is
+ *  in the tree its counters are therefore positive, and a zero counter
+ *  proves the key absent at the moment it was read. A counter that
+ *  reaches 15 stays there, which only costs false positives.
+ */
+
+#ifndef BLOOM_H_
+#define BLOOM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atomic_ops.h"
+
+#define BLOOM_COUNTERS_PER_KEY	12   // 6 bytes per expected key
+#define BLOOM_HASHES			4
+#define BLOOM_BLOCK_WORDS		8    // 64-bit words of 16 counters each
+#define BLOOM_BLOCK_COUNTERS	(BLOOM_BLOCK_WORDS * 16)
+#define BLOOM_SATURATED			15UL
+
+typedef struct bloom {
+	volatile unsigned long* words;
+	unsigned long blocks;       // power of 2
+} bloom_t;
+
+// (re)sizes f for about keys keys, all counters zero
+static inline void bloom_init(bloom_t* f, const unsigned long keys) {
+	const unsigned long wanted = (keys ? keys : 1) * BLOOM_COUNTERS_PER_KEY
+			/ BLOOM_BLOCK_COUNTERS + 1;
+	unsigned long blocks = 1;
+	while (blocks < wanted)
+		blocks <<= 1;
+	if (f->blocks != blocks) {
+		free((void*) f->words);
+		void* words;
+		if (posix_memalign(&words, 64, blocks * BLOOM_BLOCK_WORDS * 8) != 0) {
+			perror("posix_memalign");
+			exit(1);
+		}
+		f->words = (volatile unsigned long*) words;
+		f->blocks = blocks;
+	}
+	memset((void*) f->words, 0, f->blocks * BLOOM_BLOCK_WORDS * 8);
+}
+
+static inline unsigned long bloom_bytes(const bloom_t* f) {
+	return f->blocks * BLOOM_BLOCK_WORDS * 8;
+}
+
+static inline unsigned long bloom_hash(unsigned long key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdUL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53UL;
+	key ^= key >> 33;
+	return key;
+}
+
+// the word and shift of the i-th counter of key, from hash h
+static inline volatile unsigned long* bloom_counter(const bloom_t* f,
+		const unsigned long h, const int i, int* shift) {
+	const unsigned long block = h & (f->blocks - 1);
+	const unsigned int c = (h >> (32 + 7 * i)) & (BLOOM_BLOCK_COUNTERS - 1);
+	*shift = (c & 15) * 4;
+	return &f->words[block * BLOOM_BLOCK_WORDS + c / 16];
+}
+
+// adds delta (1 or -1) to the counters of key, leaving saturated ones
+static inline void bloom_update(bloom_t* f, const unsigned long key,
+		const long delta) {
+	const unsigned long h = bloom_hash(key);
+	for (int i = 0; i < BLOOM_HASHES; ++i) {
+		int shift;
+		volatile unsigned long* w = bloom_counter(f, h, i, &shift);
+		while (true) {
+			const unsigned long old = *w;
+			const unsigned long c = (old >> shift) & 15;
+			if (c == BLOOM_SATURATED || (delta < 0 && !c))
+				break;
+			const unsigned long new = delta > 0 ? old + (1UL << shift)
+					: old - (1UL << shift);
+			if (AO_compare_and_swap((AO_t*) w, old, new))
+				break;
+		}
+	}
+}
+
+static inline void bloom_add(bloom_t* f, const unsigned long key) {
+	bloom_update(f, key, 1);
+}
+
+static inline void bloom_remove(bloom_t* f, const unsigned long key) {
+	bloom_update(f, key, -1);
+}
+
+// false if key is certainly not in the set
+static inline bool bloom_contains(const bloom_t* f, const unsigned long key) {
+	const unsigned long h = bloom_hash(key);
+	for (int i = 0; i < BLOOM_HASHES; ++i) {
+		int shift;
+		volatile unsigned long* w = bloom_counter(f, h, i, &shift);
+		if (!((*w >> shift) & 15))
+			return false;
+	}
+	return true;
+}
+
+#endif /* BLOOM_H_ */
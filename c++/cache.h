@@ -0,0 +1,84 @@
+/*
+ * cache.h
+ *
+ *  Direct-mapped cache of search results for get. A slot remembers the
+ *  leaf a search for its key ended at and the leaf's parent; the tree
+ *  answers from the leaf while it is still in the tree (leaf_in_tree).
+ *  Such a leaf's key interval never shrinks, so the key is present exactly
+ *  if the leaf holds it. The SCX that unlinks the leaf marks it or its
+ *  parent first, which invalidates the slot without the update ever
+ *  writing to the cache. A slot is written only by get, under a sequence
+ *  number (odd while being written).
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <string.h>
+#include "atomic_ops.h"
+
+#define CACHE_SLOTS				4096 // power of 2
+#define CACHE_ADMIT				8    // a thread replaces a live slot once per CACHE_ADMIT misses
+
+typedef struct cache_slot {
+	volatile unsigned long seq;
+	volatile unsigned long key;
+	volatile void* leaf;
+	volatile void* parent;
+} __attribute__((aligned(32))) cache_slot_t;
+
+typedef struct cache {
+	cache_slot_t slots[CACHE_SLOTS];
+} cache_t;
+
+static __thread unsigned int cache_refused = 0; // fills this thread skipped, see CACHE_ADMIT
+
+static inline void cache_clear(cache_t* c) {
+	memset(c, 0, sizeof(cache_t));
+}
+
+static inline cache_slot_t* cache_slot(cache_t* c, const unsigned long key) {
+	const unsigned long h = key * 0x9E3779B97F4A7C15UL;
+	return &c->slots[(h >> 32) & (CACHE_SLOTS - 1)];
+}
+
+// the leaf cached for key and its parent, or NULL; the caller checks that
+// the leaf is still in the tree
+static inline volatile void* cache_lookup(cache_t* c, const unsigned long key,
+		volatile void** parent) {
+	cache_slot_t* s = cache_slot(c, key);
+	const unsigned long seq = s->seq;
+	if (seq & 1)
+		return NULL;
+	const unsigned long k = s->key;
+	volatile void* leaf = s->leaf;
+	*parent = s->parent;
+	if (s->seq != seq || k != key)
+		return NULL;
+	return leaf;
+}
+
+/*
+ * Remembers that a search for key ended at leaf, a child of parent. live
+ * tells whether a cached leaf is still in the tree; a slot whose leaf
+ * still is gets taken over only on every CACHE_ADMIT-th try of a thread,
+ * so one cold key cannot evict a hot one.
+ */
+static inline void cache_fill(cache_t* c, const unsigned long key,
+		volatile void* parent, volatile void* leaf,
+		bool (*live)(volatile void*, volatile void*)) {
+	cache_slot_t* s = cache_slot(c, key);
+	const unsigned long seq = s->seq;
+	if (seq & 1)
+		return;
+	if (s->leaf && live(s->parent, s->leaf) && ++cache_refused % CACHE_ADMIT)
+		return;
+	if (!AO_compare_and_swap((AO_t*) &s->seq, seq, seq + 1))
+		return;
+	s->key = key;
+	s->leaf = leaf;
+	s->parent = parent;
+	s->seq = seq + 2;
+}
+
+#endif /* CACHE_H_ */
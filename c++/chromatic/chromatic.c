@@ -7,11 +7,43 @@
 #include <assert.h>
 #include <limits.h>
 #include "atomic_ops.h"
+#include "../latency.h"
 #include "chromatic.h"
+#include "../elim.h"
+#include "../fc.h"
+#include "../backoff.h"
+#include "../cache.h"
+#include "../bloom.h"
+#include "../counter.h"
+#include "../snapshot.h"
+
+const char* rebalance_names[] = { "blk", "rb1", "rb2", "w1", "w2", "w3", "w4",
+		"w5", "w6", "w7", "push", null };
+
+const char* stats_gap_name = "weight";
 
 volatile operation_t* dummy = null;
 node_t* root = null;
 int d = 0; // number of violations
+int modes = 0; // MODE_* flags
+__thread finger_t finger; // this thread's last search path
+volatile node_t* right_hint = null; // parent of the rightmost leaf, see append_search
+volatile unsigned long spine_appends = 0; // appends of all threads, see insert_key
+elim_array_t elim; // insert/delete pairs, see eliminate
+fc_array_t fc; // combined updates of contended threads, see fc.h
+cache_t cache; // leaves recent gets ended at, see cache.h
+bloom_t bloom; // keys that may be in the set, see bloom.h
+unsigned long expected_keys = 0; // see reserve
+unsigned long expected_range = 0;
+counter_t key_count; // keys in the set, see tree_size
+volatile unsigned long snapshot_version = 1; // tag of new updates, see snapshot.h
+__thread unsigned long fix_ticks = 0; // ticks spent in fix_to_key by this thread
+#ifdef SCX_STATS
+__thread scx_stats_t scx_stats;
+#endif
+#ifdef MEM_STATS
+__thread mem_stats_t mem_stats;
+#endif
 
 int init_node(node_t* node_ptr, const unsigned long key, const unsigned long weight, volatile node_t* left, volatile node_t* right,
 		volatile operation_t* op) {
@@ -22,6 +54,14 @@ int init_node(node_t* node_ptr, const unsigned long key, const unsigned long wei
 	node_ptr->right = right;
 	node_ptr->marked = false;
 	node_ptr->op = op;
+#ifdef RANK_COUNTS
+	node_ptr->count = left ? keys_below(left) + keys_below(right)
+			: key != ULONG_MAX;
+#endif
+#ifdef SNAPSHOT_VERSIONS
+	node_ptr->version = 0; // in every snapshot with its parent
+	node_ptr->replaced = null;
+#endif
 	return SUCCESS;
 }
 
@@ -54,6 +94,21 @@ int init_op(operation_t* op_ptr) {
 	return SUCCESS;
 }
 
+void init_range_op(range_operation_t* op_ptr) {
+	init_op(&op_ptr->op);
+}
+
+// a range op is built in its own arrays, but help_scx reads nodes[0] and
+// nodes[1] from op, and all of them if they fit there
+static volatile operation_t* range_op_done(range_operation_t* op_ptr) {
+	const int n = op_ptr->op.ops_size > MAX_OPS_SIZE ? 2 : op_ptr->op.ops_size;
+	for (int i = 0; i < n; ++i) {
+		op_ptr->op.nodes[i] = op_ptr->nodes[i];
+		op_ptr->op.ops[i] = op_ptr->ops[i];
+	}
+	return &op_ptr->op;
+}
+
 void clear_op(volatile operation_t* op_ptr) {
 	op_ptr->subtree = 0;
 	op_ptr->ops_size = 0;
@@ -66,11 +121,17 @@ volatile operation_t* weak_llx(volatile node_t* node) {
 	if (state == STATE_ABORTED || (state == STATE_COMMITTED && !node->marked)) {
 		return node_info;
 	}
-	if (node_info->state == STATE_INPROGRESS) {
-		help_scx(node_info, 1);
-	} else if (node->op->state == STATE_INPROGRESS) {
-		help_scx(node->op, 1);
+	volatile operation_t* busy = node_info;
+	if (busy->state != STATE_INPROGRESS)
+		busy = node->op;
+	// either way the node is not ready; with MODE_LAZY_HELP its owner gets a
+	// few spins to finish before we help
+	if (busy->state == STATE_INPROGRESS && (!(modes & MODE_LAZY_HELP)
+			|| help_wait(&busy->state, STATE_INPROGRESS))) {
+		STAT_INC(llx_helps);
+		help_scx(busy, 1);
 	}
+	STAT_INC(llx_fails);
 	return null;
 }
 
@@ -82,16 +143,37 @@ bool help_scx(volatile operation_t* op, const int start_index) {
 	// so, we return.
 	if (op->state != STATE_INPROGRESS)
 		return true;
+	if (start_index == 0) {
+		STAT_INC(scx_attempts);
+#ifdef SNAPSHOT_VERSIONS
+		if (modes & MODE_SNAPSHOT) {
+			// the new subtree is not reachable yet, see snapshot.h
+			op->subtree->version = snapshot_tag;
+			op->subtree->replaced = op->nodes[1];
+		}
+#endif
+	}
+
+	// only range ops outgrow their inline arrays, see range_operation_t
+	const int ops_size = op->ops_size;
+	volatile node_t* volatile* nodes = op->nodes;
+	volatile operation_t* volatile* ops = op->ops;
+	if (ops_size > MAX_OPS_SIZE) {
+		nodes = ((volatile range_operation_t*) op)->nodes;
+		ops = ((volatile range_operation_t*) op)->ops;
+	}
 
 	// freeze sub-tree
-	for (int i = start_index; i < op->ops_size; ++i) {
+	for (int i = start_index; i < ops_size; ++i) {
 		// if work was not done
-		if (!AO_compare_and_swap((AO_t*)(&(op->nodes[i]->op)), (AO_t)(op->ops[i]),
-				(AO_t)(op)) && op->nodes[i]->op != op) {
+		if (!AO_compare_and_swap((AO_t*)(&(nodes[i]->op)), (AO_t)(ops[i]),
+				(AO_t)(op)) && nodes[i]->op != op) {
 			if (op->all_frozen) {
 				return true;
 			} else {
 				op->state = STATE_ABORTED;
+				if (start_index == 0)
+					STAT_INC(scx_aborts);
 				// help the garbage collector (must be AFTER we set state
 				// committed or aborted)
 //				clear_op(op);
@@ -100,18 +182,23 @@ bool help_scx(volatile operation_t* op, const int start_index) {
 		}
 	}
 	op->all_frozen = true;
-	for (int i = 1; i < op->ops_size; ++i)
-		op->nodes[i]->marked = true; // finalize all but first node
+	for (int i = 1; i < ops_size; ++i)
+		nodes[i]->marked = true; // finalize all but first node
 
-	// CAS in the new sub-tree (child-cas)
+	// CAS in the new sub-tree (child-cas); only the winner counts the
+	// finalized nodes, which are unlinked by it
 	if (op->nodes[0]->left == op->nodes[1]) {
-		AO_compare_and_swap((AO_t*)(&(op->nodes[0]->left)), (AO_t)(op->nodes[1]),
-				(AO_t)(op->subtree));
+		if (AO_compare_and_swap((AO_t*)(&(op->nodes[0]->left)),
+				(AO_t)(op->nodes[1]), (AO_t)(op->subtree)))
+			MEM_ADD(retired, ops_size - 1);
 	} else { // assert: op->nodes[0].right == op->nodes[1]
-		AO_compare_and_swap((AO_t*)(&(op->nodes[0]->right)), (AO_t)(op->nodes[1]),
-				(AO_t)(op->subtree));
+		if (AO_compare_and_swap((AO_t*)(&(op->nodes[0]->right)),
+				(AO_t)(op->nodes[1]), (AO_t)(op->subtree)))
+			MEM_ADD(retired, ops_size - 1);
 	}
 	op->state = STATE_COMMITTED;
+	if (start_index == 0)
+		STAT_INC(scx_commits);
 
 	// help the garbage collector (must be AFTER we set state committed or
 	// aborted)
@@ -121,61 +208,166 @@ bool help_scx(volatile operation_t* op, const int start_index) {
 
 int init_tree(const int all_violation_per_path) {
 	int rc = SUCCESS;
-	dummy = (operation_t*) xmalloc(sizeof(operation_t));
+	dummy = alloc_op();
 	rc = init_dummy_op(dummy);
 
 	d = all_violation_per_path;
 
-	node_t* sentinel = (node_t*) xmalloc(sizeof(node_t));
+	node_t* sentinel = alloc_node();
 	rc = init_node(sentinel, ULONG_MAX, 1, null, null, dummy);
 
-	root = (node_t*) xmalloc(sizeof(node_t));
+	root = alloc_node();
 	rc = init_node(root, ULONG_MAX, 1, sentinel, null, dummy);
 
 	if (rc)
 		return rc;
 
+	finger.depth = 0; // the calling thread's path is in the old tree
+	right_hint = null;
+	fc_reset(&fc, expected_range);
+	cache_clear(&cache);
+	if (modes & MODE_BLOOM)
+		bloom_init(&bloom, expected_keys);
+	counter_reset(&key_count);
 	return SUCCESS;
 }
 
+void set_modes(const int m) {
+	modes = m;
+}
+
+void reserve(const unsigned long keys, const unsigned long range) {
+	expected_keys = keys;
+	expected_range = range;
+}
+
+// from the per-thread counts of successful updates; without MODE_SIZE it
+// misses the updates in progress
 int tree_size() {
-	return sequential_size(root);
+	return modes & MODE_SIZE ? counter_exact(&key_count)
+			: counter_sum(&key_count);
+}
+
+static bool cached_leaf_live(volatile void* p, volatile void* l) {
+	return leaf_in_tree((volatile node_t*) p, (volatile node_t*) l);
 }
 
 bool get(const unsigned long key) {
-	volatile node_t* l = root->left->left;
-	if (!l)
-		return false; // no keys in data structure
-	while (l->left) {
-		l = key < l->key ? l->left : l->right;
+	volatile node_t* p;
+	volatile node_t* l;
+	if ((modes & MODE_BLOOM) && !bloom_contains(&bloom, key)) {
+		STAT_INC(bloom_negatives);
+		return false;
 	}
-	if (l->key == key) {
-		return true;
+	if (modes & MODE_CACHE) {
+		l = cache_lookup(&cache, key, (volatile void**) &p);
+		if (l && leaf_in_tree(p, l)) {
+			STAT_INC(cache_hits);
+			return l->key == key;
+		}
+		STAT_INC(cache_misses);
+	}
+	if (modes & MODE_FINGER) {
+		finger_search(key, null, &p, &l);
 	} else {
-		return false;
+		p = root->left;
+		l = p->left;
+		if (!l) {
+			return false; // no keys in data structure
+		}
+		while (l->left) {
+			p = l;
+			l = key < l->key ? l->left : l->right;
+		}
 	}
+	if (modes & MODE_CACHE)
+		cache_fill(&cache, key, p, l, cached_leaf_live);
+	if ((modes & MODE_BLOOM) && l->key != key)
+		STAT_INC(bloom_false_positives);
+	return l->key == key;
 }
 
 bool insert(const unsigned long key) {
+	if ((modes & MODE_COMBINE) && fc_contended())
+		return fc_apply(&fc, key, FC_INSERT, insert, delete);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		snapshot_enter(&key_count, &snapshot_version);
+	if (modes & MODE_BLOOM)
+		bloom_add(&bloom, key); // before the key can be found, see bloom.h
+	const bool added = insert_key(key);
+	if (added)
+		counter_add(&key_count, 1);
+	else if (modes & MODE_BLOOM)
+		bloom_remove(&bloom, key);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		counter_leave(&key_count);
+	return added;
+}
+
+bool delete(const unsigned long key) {
+	if ((modes & MODE_COMBINE) && fc_contended())
+		return fc_apply(&fc, key, FC_DELETE, insert, delete);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		snapshot_enter(&key_count, &snapshot_version);
+	const bool removed = delete_key(key);
+	if (removed) {
+		counter_add(&key_count, -1);
+		if (modes & MODE_BLOOM)
+			bloom_remove(&bloom, key);
+	}
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		counter_leave(&key_count);
+	return removed;
+}
+
+// delete_range_keys with the bookkeeping of delete
+unsigned long delete_range(const unsigned long lo, const unsigned long hi) {
+	if (lo > hi)
+		return 0;
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		snapshot_enter(&key_count, &snapshot_version);
+	const unsigned long removed = delete_range_keys(lo,
+			hi < ULONG_MAX ? hi : ULONG_MAX - 1);
+	counter_add(&key_count, -(long) removed);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		counter_leave(&key_count);
+	return removed;
+}
+
+bool insert_key(const unsigned long key) {
 	volatile operation_t* op = null;
 	volatile node_t* p = null;
 	volatile node_t* l = null;
 	int count = 0;
+	bool append = false;
+	int attempts = 0; // searches; elimination is offered on the first retry
+	if ((modes & MODE_ELIM) && elim_take(&elim, key, ELIM_INSERT)) {
+		STAT_INC(elim_hits);
+		return true;
+	}
 	while (true) {
 		while (op == null) {
-			p = root;
-			l = root->left;
-			if (l->left != null) {
-				count = 0;
-				p = l;
-				l = l->left; // note: before executing this line, l must have key infinity, and l.left must not.
-				while (l->left != null) {
-					if (d > 0
-							&& (l->weight > 1
-									|| (l->weight == 0 && p->weight == 0)))
-						++count;
+			++attempts;
+			append = (modes & MODE_APPEND) && append_search(key, &p, &l);
+			if (append) {
+				// p and l are the rightmost leaf and its parent
+			} else if (modes & MODE_FINGER) {
+				count = finger_search(key, null, &p, &l);
+			} else {
+				p = root;
+				l = root->left;
+				if (l->left != null) {
+					count = 0;
 					p = l;
-					l = key < l->key ? l->left : l->right;
+					l = l->left; // note: before executing this line, l must have key infinity, and l.left must not.
+					while (l->left != null) {
+						if (d > 0
+								&& (l->weight > 1
+										|| (l->weight == 0 && p->weight == 0)))
+							++count;
+						p = l;
+						l = key < l->key ? l->left : l->right;
+					}
 				}
 			}
 
@@ -183,10 +375,39 @@ bool insert(const unsigned long key) {
 			if (l->key == key) {
 				return false;
 			} else {
+				if ((modes & MODE_ELIM) && attempts == 2) {
+					if (eliminate(key, ELIM_INSERT, p, l))
+						return true;
+				}
 				op = create_insert_operation(p, l, key);
+				if (!op) {
+					STAT_INC(create_null);
+					fc_conflict();
+					if (modes & MODE_BACKOFF)
+						backoff_abort();
+					finger.depth = 0; // the path may be stale
+				}
 			}
 		}
 		if (help_scx(op, 0)) {
+			if (modes & MODE_BACKOFF)
+				backoff_commit();
+			if (modes & MODE_RANK)
+				count_update(key, op->subtree);
+			if (append) {
+				right_hint = op->subtree;
+				if (d > 0) {
+					// the violations of up to d - 1 appends wait on the right
+					// spine; the append that completes a batch, whichever
+					// thread made it, repairs the whole spine
+					const unsigned long batch = d < APPEND_FIX_BATCH ? d
+							: APPEND_FIX_BATCH;
+					if ((AO_fetch_and_add_full((AO_t*) &spine_appends, 1) + 1)
+							% batch == 0)
+						fix_to_key(ULONG_MAX - 1);
+					return true;
+				}
+			}
 			// clean up violations if necessary
 			if (d == 0) {
 				if (p->weight == 0 && l->weight == 1)
@@ -197,34 +418,47 @@ bool insert(const unsigned long key) {
 			}
 			return true;
 		}
+		fc_conflict(); // the SCX lost to a concurrent one
+		if (modes & MODE_BACKOFF)
+			backoff_abort();
 		op = null;
 	}
 }
 
-bool delete(const unsigned long key) {
+bool delete_key(const unsigned long key) {
 	volatile node_t* gp = null;
 	volatile node_t* p = null;
 	volatile node_t* l = null;
 	volatile operation_t* op = null;
 	int count = 0;
+	int attempts = 0; // searches; elimination is offered on the first retry
+	if ((modes & MODE_ELIM) && elim_take(&elim, key, ELIM_DELETE)) {
+		STAT_INC(elim_hits);
+		return true;
+	}
 	while (true) {
 		while (op == null) {
-			gp = null;
-			p = root;
-			l = root->left;
-			if (l->left != null) {
-				count = 0;
-				gp = p;
-				p = l;
-				l = l->left; // note: before executing this line, l must have key infinity, and l->left must not.
-				while (l->left != null) {
-					if (d > 0
-							&& (l->weight > 1
-									|| (l->weight == 0 && p->weight == 0)))
-						++count;
+			++attempts;
+			if (modes & MODE_FINGER) {
+				count = finger_search(key, &gp, &p, &l);
+			} else {
+				gp = null;
+				p = root;
+				l = root->left;
+				if (l->left != null) {
+					count = 0;
 					gp = p;
 					p = l;
-					l = key < l->key ? l->left : l->right;
+					l = l->left; // note: before executing this line, l must have key infinity, and l->left must not.
+					while (l->left != null) {
+						if (d > 0
+								&& (l->weight > 1
+										|| (l->weight == 0 && p->weight == 0)))
+							++count;
+						gp = p;
+						p = l;
+						l = key < l->key ? l->left : l->right;
+					}
 				}
 			}
 
@@ -232,10 +466,26 @@ bool delete(const unsigned long key) {
 			if (l->key != key) {
 				return false;
 			} else {
+				if ((modes & MODE_ELIM) && attempts == 2) {
+					if (eliminate(key, ELIM_DELETE, p, l))
+						return true;
+				}
 				op = create_remove_operation(gp, p, l);
+				if (!op) {
+					STAT_INC(create_null);
+					fc_conflict();
+					if (modes & MODE_BACKOFF)
+						backoff_abort();
+					finger.depth = 0; // the path may be stale
+				}
 			}
 		}
 		if (help_scx(op, 0)) {
+			MEM_INC(retired); // l, which the remove unlinks without freezing
+			if (modes & MODE_BACKOFF)
+				backoff_commit();
+			if (modes & MODE_RANK)
+				count_update(key, op->subtree);
 			// clean up violations if necessary
 			if (d == 0) {
 				if (p->weight > 0 && l->weight > 0 && !is_sentinel(p))
@@ -247,10 +497,347 @@ bool delete(const unsigned long key) {
 			// we deleted a key, so we return the removed value (saved in the old node)
 			return true;
 		}
+		fc_conflict(); // the SCX lost to a concurrent one
+		if (modes & MODE_BACKOFF)
+			backoff_abort();
 		op = null;
 	}
 }
 
+// whether leaf l, found as a child of p, is still in the tree. A remove
+// does not freeze the leaf it unlinks, only its parent, so an unmarked
+// leaf alone proves nothing.
+bool leaf_in_tree(volatile node_t* p, volatile node_t* l) {
+	return (p->left == l || p->right == l) && !p->marked && !l->marked;
+}
+
+/*
+ * The first subtree below n, in key order, whose routing keys put all of
+ * its keys in [lo, hi], or failing that the first leaf in [lo, hi]; null
+ * if there is none. n is a child of p and p of gp, and [klo, khi) are the
+ * keys the nodes above n route to it. Only the search paths of lo and hi
+ * are walked: every other node in the range lies below one the walk
+ * returns.
+ */
+static volatile node_t* range_find(volatile node_t* gp, volatile node_t* p,
+		volatile node_t* n, const unsigned long klo, const unsigned long khi,
+		const unsigned long lo, const unsigned long hi,
+		volatile node_t** gp_ptr, volatile node_t** p_ptr) {
+	if (!n)
+		return null;
+	if ((klo >= lo && khi - 1 <= hi)
+			|| (!n->left && n->key >= lo && n->key <= hi)) {
+		*gp_ptr = gp;
+		*p_ptr = p;
+		return n;
+	}
+	if (!n->left)
+		return null;
+	if (n->key >= lo && khi - 1 <= hi) {
+		// the right child is in the range, while the left one is not known
+		// to be: once the keys left of the range are gone, the nodes on the
+		// path of lo still route keys below lo to their left children
+		*gp_ptr = p;
+		*p_ptr = n;
+		return n->right;
+	}
+	volatile node_t* x = null;
+	if (lo < n->key)
+		x = range_find(p, n, n->left, klo, n->key, lo, hi, gp_ptr, p_ptr);
+	if (!x && hi >= n->key)
+		x = range_find(p, n, n->right, n->key, khi, lo, hi, gp_ptr, p_ptr);
+	return x;
+}
+
+// the internal nodes below n, which range_collect freezes, counted up to
+// limit + 1
+static int range_size(volatile node_t* n, const int limit) {
+	if (!n->left)
+		return 0;
+	if (limit < 1)
+		return limit + 1;
+	const int left = range_size(n->left, limit - 1);
+	if (left > limit - 1)
+		return limit + 1;
+	return 1 + left + range_size(n->right, limit - 1 - left);
+}
+
+// x, or else the highest node on its left path small enough for one
+// range removal; *gp_ptr and *p_ptr follow it down
+static volatile node_t* range_fit(volatile node_t* x, volatile node_t** gp_ptr,
+		volatile node_t** p_ptr) {
+	while (x->left && range_size(x, RANGE_SUBTREE_MAX) > RANGE_SUBTREE_MAX) {
+		*gp_ptr = *p_ptr;
+		*p_ptr = x;
+		x = x->left;
+	}
+	return x;
+}
+
+// the keys below n, which a committed range removal froze and unlinked
+static unsigned long range_detached(volatile node_t* n) {
+	if (n->left)
+		return range_detached(n->left) + range_detached(n->right);
+	if (modes & MODE_BLOOM)
+		bloom_remove(&bloom, n->key); // after the key left, see bloom.h
+	return 1;
+}
+
+/*
+ * Removes the keys in [lo, hi] and returns their number. Each SCX
+ * detaches a whole subtree with at most RANGE_SUBTREE_MAX internal nodes
+ * in the range, replacing its parent by its sibling like delete_key does
+ * for a leaf; only the nodes on the paths of lo and hi are left to remove
+ * one leaf at a time. The overweight siblings all end up on those two
+ * paths, so instead of a fix_to_key per SCX there is one per path at the
+ * end. Keys inserted into the range meanwhile may stay.
+ */
+unsigned long delete_range_keys(const unsigned long lo, const unsigned long hi) {
+	unsigned long removed = 0;
+	while (true) {
+		volatile node_t* gp;
+		volatile node_t* p;
+		volatile node_t* x = root->left->left ? range_find(root, root->left,
+				root->left->left, 0, ULONG_MAX, lo, hi, &gp, &p) : null;
+		if (!x)
+			break;
+		x = range_fit(x, &gp, &p);
+		bool too_big = false;
+		volatile operation_t* op = create_range_operation(gp, p, x, lo, hi,
+				&too_big);
+		while (!op && too_big) {
+			// x grew meanwhile; every node below it is in the range
+			gp = p;
+			p = x;
+			x = x->left;
+			too_big = false;
+			op = create_range_operation(gp, p, x, lo, hi, &too_big);
+		}
+		if (op && help_scx(op, 0)) {
+			if (modes & MODE_BACKOFF)
+				backoff_commit();
+			const unsigned long leaves = range_detached(x);
+			MEM_ADD(retired, leaves); // unlinked without freezing, like l in delete_key
+			removed += leaves;
+			if (modes & MODE_RANK)
+				count_update(x->key, op->subtree);
+			continue;
+		}
+		if (!op)
+			STAT_INC(create_null);
+		if (modes & MODE_BACKOFF)
+			backoff_abort();
+	}
+	if (removed) {
+		fix_to_key(lo);
+		fix_to_key(hi);
+	}
+	return removed;
+}
+
+// offers an update that found leaf l under p to a partner, see elim.h
+bool eliminate(const unsigned long key, const int type, volatile node_t* p,
+		volatile node_t* l) {
+	STAT_INC(elim_offers);
+	elim_slot_t* s = elim_offer(&elim, key, type);
+	if (!s)
+		return false;
+	const bool valid = leaf_in_tree(p, l);
+	elim_answer(s, valid);
+	if (valid)
+		STAT_INC(elim_hits);
+	return valid;
+}
+
+// in append mode: the rightmost leaf and its parent, if key goes right of
+// the leaf. The hint left by the last append is used while its node is
+// not marked: such a node is still on the right spine, so a leaf right
+// child of it is the rightmost leaf. Otherwise walks down the spine.
+bool append_search(const unsigned long key, volatile node_t** p_ptr,
+		volatile node_t** l_ptr) {
+	volatile node_t* p = right_hint;
+	volatile node_t* l = p ? p->right : null;
+	if (!p || p->marked || !l || l->left) {
+		p = root->left;
+		l = p->left;
+		if (!l)
+			return false; // only sentinels in tree
+		while (l->left) {
+			p = l;
+			l = l->right;
+		}
+	}
+	if (is_sentinel(l) || key <= l->key)
+		return false;
+	*p_ptr = p;
+	*l_ptr = l;
+	return true;
+}
+
+// one attempt to set the count of internal node n from its children
+static bool count_refresh_once(volatile node_t* n) {
+#ifdef RANK_COUNTS
+	const unsigned long old = n->count;
+	const unsigned long keys = keys_below(n->left) + keys_below(n->right);
+	return AO_compare_and_swap((AO_t*) &n->count, (AO_t) old,
+			(AO_t) COUNT_WORD(COUNT_VERSION(old) + 1, keys));
+#else
+	return true;
+#endif
+}
+
+static void count_refresh(volatile node_t* n) {
+	if (!count_refresh_once(n))
+		count_refresh_once(n);
+}
+
+static void count_refresh_subtree(volatile node_t* n, const int depth) {
+	if (!n || !n->left)
+		return;
+	if (depth > 0) {
+		count_refresh_subtree(n->left, depth - 1);
+		count_refresh_subtree(n->right, depth - 1);
+	}
+	count_refresh(n);
+}
+
+// refreshes the search path of key below n, bottom-up; true if one of its
+// nodes was unlinked meanwhile
+static bool count_refresh_path(volatile node_t* n, const unsigned long key) {
+	if (!n->left)
+		return false;
+	const bool stale = count_refresh_path(key < n->key ? n->left : n->right,
+			key);
+	count_refresh(n);
+	return stale || n->marked;
+}
+
+// after a committed SCX that installed subtree on the search path of key,
+// see rank.h
+void count_update(const unsigned long key, volatile node_t* subtree) {
+	count_refresh_subtree(subtree, COUNT_SUBTREE_DEPTH);
+	while (count_refresh_path(root, key))
+		STAT_INC(count_restarts);
+}
+
+// the number of keys smaller than key
+unsigned long key_rank(const unsigned long key) {
+	unsigned long below = 0;
+	volatile node_t* n = root;
+	while (n->left) {
+		if (key < n->key) {
+			n = n->left;
+		} else {
+			below += keys_below(n->left);
+			n = n->right;
+			if (!n)
+				return below; // right of the root: key is ULONG_MAX
+		}
+	}
+	return below + (n->key < key);
+}
+
+// the key with i smaller ones, if there are more than i keys
+bool key_select(const unsigned long i, unsigned long* key) {
+	unsigned long rest = i;
+	volatile node_t* n = root;
+	while (n->left) {
+		const unsigned long left = keys_below(n->left);
+		if (rest < left) {
+			n = n->left;
+		} else {
+			rest -= left;
+			n = n->right;
+			if (!n)
+				return false;
+		}
+	}
+	if (rest || n->key == ULONG_MAX)
+		return false;
+	*key = n->key;
+	return true;
+}
+
+// visits the keys in [lo, hi] below n as of version v, in order
+static unsigned long scan_node(volatile node_t* n, const unsigned long v,
+		const unsigned long lo, const unsigned long hi,
+		void (*visit)(const unsigned long key, void* arg), void* arg) {
+	if (!n)
+		return 0;
+	if (!n->left) {
+		if (n->key < lo || n->key > hi || n->key == ULONG_MAX)
+			return 0;
+		visit(n->key, arg);
+		return 1;
+	}
+	unsigned long keys = 0;
+	if (lo < n->key)
+		keys += scan_node(snapshot_child(n->left, v), v, lo, hi, visit, arg);
+	if (hi >= n->key)
+		keys += scan_node(snapshot_child(n->right, v), v, lo, hi, visit, arg);
+	return keys;
+}
+
+// calls visit on the keys in [lo, hi] in order and returns their number;
+// in MODE_SNAPSHOT they are the keys of one instant, otherwise the scan
+// may see some concurrent updates and miss others
+unsigned long scan(const unsigned long lo, const unsigned long hi,
+		void (*visit)(const unsigned long key, void* arg), void* arg) {
+	const unsigned long v = modes & MODE_SNAPSHOT ?
+			snapshot_begin(&key_count, &snapshot_version) : ULONG_MAX;
+	return scan_node(root, v, lo, hi, visit, arg);
+}
+
+// the search of insert and delete, started from the deepest unmarked node
+// of the thread's last path that covers key; records the new path and
+// returns the violations counted along it (those above the starting node
+// as they were when it was recorded)
+int finger_search(const unsigned long key, volatile node_t** gp_ptr,
+		volatile node_t** p_ptr, volatile node_t** l_ptr) {
+	volatile node_t* gp = root;
+	volatile node_t* p = root;
+	volatile node_t* l = root->left;
+	unsigned long lo = 0;
+	unsigned long hi = ULONG_MAX;
+	int count = 0;
+	const int i = finger_find(&finger, key);
+	if (i >= 1 && !((volatile node_t*) finger.path[i].node)->marked) {
+		gp = i >= 2 ? (volatile node_t*) finger.path[i - 2].node : root->left;
+		p = (volatile node_t*) finger.path[i - 1].node;
+		l = (volatile node_t*) finger.path[i].node;
+		lo = finger.path[i].lo;
+		hi = finger.path[i].hi;
+		count = finger.path[i - 1].count;
+		finger.depth = i;
+	} else {
+		finger.depth = 0;
+		if (l->left) {
+			gp = p;
+			p = l;
+			l = l->left;
+		}
+	}
+	while (l->left) {
+		if (d > 0 && (l->weight > 1 || (l->weight == 0 && p->weight == 0)))
+			++count;
+		finger_push(&finger, l, lo, hi, count);
+		gp = p;
+		p = l;
+		if (key < l->key) {
+			hi = l->key;
+			l = l->left;
+		} else {
+			lo = l->key;
+			l = l->right;
+		}
+	}
+	if (gp_ptr)
+		*gp_ptr = gp;
+	*p_ptr = p;
+	*l_ptr = l;
+	return count;
+}
+
 void print_tree() {
 	print_tree_node(root, 0);
 }
@@ -279,13 +866,17 @@ void print_tree_node(volatile node_t* node, const int level) {
 }
 
 void fix_to_key(const unsigned long key) {
+	FIX_TIMER_START(start);
+	STAT_INC(fix_calls);
 	while (true) {
 		volatile node_t* ggp;
 		volatile node_t* gp;
 		volatile node_t* p;
 		volatile node_t* l = root->left;
-		if (l->left == null)
+		if (l->left == null) {
+			FIX_TIMER_STOP(start, fix_ticks);
 			return; // only sentinels in tree...
+		}
 		ggp = gp = root;
 		p = l;
 		l = l->left; // note: before executing this line, l must have key infinity, and l.left must not.
@@ -296,20 +887,26 @@ void fix_to_key(const unsigned long key) {
 			p = l;
 			l = key < l->key ? l->left : l->right;
 		}
-		if (l->weight == 1)
+		if (l->weight == 1) {
+			FIX_TIMER_STOP(start, fix_ticks);
 			return; // if no violation, then the search hit a leaf, so we can stop
+		}
 
 		volatile operation_t* op = create_balancing_operation(ggp, gp, p, l);
 		if (op != null) {
-			help_scx(op, 0);
+			if (help_scx(op, 0) && (modes & MODE_RANK))
+				count_update(key, op->subtree);
+		} else {
+			STAT_INC(create_null);
 		}
+		STAT_INC(fix_restarts);
 	}
 }
 
 volatile operation_t* create_insert_operation(volatile node_t* p,
 		volatile node_t* l, const unsigned long key) {
 
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = INSERT_OPS_SIZE;
 
@@ -330,12 +927,12 @@ volatile operation_t* create_insert_operation(volatile node_t* p,
 	const int new_weight = (is_sentinel(l) ? 1 : l->weight - 1); // (maintain sentinel weights at 1)
 
 	// Build new sub-tree
-	node_t* new_leaf = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_leaf = alloc_node();
 	init_node(new_leaf, key, 1, null, null, dummy);
-	node_t* new_l = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_l = alloc_node();
 	init_node(new_l, l->key, 1, null, null, dummy);
 
-	node_t* new_p = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_p = alloc_node();
 	if (key < l->key) {
 		init_node(new_p, l->key, new_weight, new_leaf, new_l, dummy);
 
@@ -349,7 +946,7 @@ volatile operation_t* create_insert_operation(volatile node_t* p,
 
 volatile operation_t* create_remove_operation(volatile node_t* gp,
 		volatile node_t* p, volatile node_t* l) {
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = REMOVE_OPS_SIZE;
 
@@ -380,13 +977,79 @@ volatile operation_t* create_remove_operation(volatile node_t* gp,
 	const int new_weight = (is_sentinel(p) ? 1 : p->weight + s->weight); // weights of parent + sibling of deleted leaf
 
 	// Build new sub-tree
-	node_t* new_p = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_p = alloc_node();
 	init_node(new_p, s->key, new_weight, s->left, s->right, dummy);
 	new_op->subtree = new_p;
 
 	return new_op;
 }
 
+// adds the internal nodes below n to the removal op in preorder; false if
+// an LLX fails, a leaf is outside [lo, hi] or there are more than
+// RANGE_SUBTREE_MAX of them (*too_big). Leaves are not frozen: they never
+// change, and their parents are (see leaf_in_tree).
+static bool range_collect(range_operation_t* op, volatile node_t* n,
+		const unsigned long lo, const unsigned long hi, bool* too_big) {
+	if (!n->left)
+		return n->key >= lo && n->key <= hi;
+	if (op->op.ops_size == 3 + RANGE_SUBTREE_MAX) {
+		*too_big = true;
+		return false;
+	}
+	const int i = op->op.ops_size++;
+	op->nodes[i] = n;
+	op->ops[i] = weak_llx(n);
+	if (!op->ops[i])
+		return false;
+	return range_collect(op, n->left, lo, hi, too_big)
+			&& range_collect(op, n->right, lo, hi, too_big);
+}
+
+// replaces p by a copy of the sibling of x, like a removal of the whole
+// subtree x; all of its internal nodes are frozen, so nothing enters it
+// before it is gone
+volatile operation_t* create_range_operation(volatile node_t* gp,
+		volatile node_t* p, volatile node_t* x, const unsigned long lo,
+		const unsigned long hi, bool* too_big) {
+	range_operation_t* new_op = alloc_range_op();
+	init_range_op(new_op);
+
+	new_op->nodes[0] = gp;
+	new_op->ops[0] = weak_llx(gp);
+	if (!new_op->ops[0])
+		return null;
+
+	if (p != gp->left && p != gp->right)
+		return null;
+
+	new_op->nodes[1] = p;
+	new_op->ops[1] = weak_llx(p);
+	if (!new_op->ops[1])
+		return null;
+
+	const bool left = x == p->left;
+	if (!left && x != p->right)
+		return null;
+
+	volatile node_t* s = left ? p->right : p->left;
+	new_op->nodes[2] = s;
+	new_op->ops[2] = weak_llx(s);
+	if (!new_op->ops[2])
+		return null;
+
+	new_op->op.ops_size = 3;
+	if (!range_collect(new_op, x, lo, hi, too_big))
+		return null;
+
+	// the weights on every path through s stay the same, as in a removal
+	const int new_weight = (is_sentinel(p) ? 1 : p->weight + s->weight);
+	node_t* new_p = alloc_node();
+	init_node(new_p, s->key, new_weight, s->left, s->right, dummy);
+	new_op->op.subtree = new_p;
+
+	return range_op_done(new_op);
+}
+
 volatile operation_t* create_balancing_operation(volatile node_t* f,
 		volatile node_t* fX, volatile node_t* fXX, volatile node_t* fXXX) {
 	volatile operation_t* opf = weak_llx(f);
@@ -435,7 +1098,7 @@ volatile operation_t* create_balancing_operation(volatile node_t* f,
 				if (opfXR == null)
 					return null;
 
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = BLK_OPS_SIZE;
 
@@ -451,7 +1114,7 @@ volatile operation_t* create_balancing_operation(volatile node_t* f,
 				return createBlkOp(new_op);
 
 			} else if (fXXXleft) {
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 
 				new_op->ops_size = RB1_OPS_SIZE;
@@ -469,7 +1132,7 @@ volatile operation_t* create_balancing_operation(volatile node_t* f,
 				if (opfXXR == null)
 					return null;
 
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = RB2_OPS_SIZE;
 
@@ -490,7 +1153,7 @@ volatile operation_t* create_balancing_operation(volatile node_t* f,
 				volatile operation_t* opfXL = weak_llx(fXL);
 				if (opfXL == null)
 					return null;
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = BLK_OPS_SIZE;
 
@@ -506,7 +1169,7 @@ volatile operation_t* create_balancing_operation(volatile node_t* f,
 				return createBlkOp(new_op);
 
 			} else if (!fXXXleft) {
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = RB1SYM_OPS_SIZE;
 
@@ -523,7 +1186,7 @@ volatile operation_t* create_balancing_operation(volatile node_t* f,
 				volatile operation_t* opfXXL = weak_llx(fXXL);
 				if (opfXXL == null)
 					return null;
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = RB2SYM_OPS_SIZE;
 
@@ -558,7 +1221,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 					if (opfXR == null)
 						return null;
 
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 
 					new_op->ops_size = BLK_OPS_SIZE;
@@ -579,7 +1242,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 					if (opfXXR == null)
 						return null;
 
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = RB2_OPS_SIZE;
 
@@ -601,7 +1264,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 					if (opfXL == null)
 						return null;
 
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = BLK_OPS_SIZE;
 
@@ -617,7 +1280,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 					return createBlkOp(new_op);
 
 				} else {
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = RB1SYM_OPS_SIZE;
 
@@ -644,7 +1307,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 
 			if (fXXRL->weight > 1) {
 
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = W1_OPS_SIZE;
 
@@ -662,7 +1325,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 				return createW1Op(new_op);
 
 			} else if (fXXRL->weight == 0) {
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = RB2SYM_OPS_SIZE;
 
@@ -685,7 +1348,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 					volatile operation_t* opfXXRLR = weak_llx(fXXRLR);
 					if (opfXXRLR == null)
 						return null;
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 
 					new_op->ops_size = W4_OPS_SIZE;
@@ -713,7 +1376,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 						if (opfXXRLL == null)
 							return null;
 
-						operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+						operation_t* new_op = alloc_op();
 						init_op(new_op);
 						new_op->ops_size = W3_OPS_SIZE;
 
@@ -732,7 +1395,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 						new_op->ops[5] = opfXXRLL;
 						return createW3Op(new_op);
 					} else { // assert: fXXRLL->weight > 0
-						operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+						operation_t* new_op = alloc_op();
 						init_op(new_op);
 						new_op->ops_size = W2_OPS_SIZE;
 
@@ -765,7 +1428,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 			volatile operation_t* opfXXRR = weak_llx(fXXRR);
 			if (opfXXRR == null)
 				return null;
-			operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+			operation_t* new_op = alloc_op();
 			init_op(new_op);
 			new_op->ops_size = W5_OPS_SIZE;
 
@@ -785,7 +1448,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 			volatile operation_t* opfXXRL = weak_llx(fXXRL);
 			if (opfXXRL == null)
 				return null;
-			operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+			operation_t* new_op = alloc_op();
 			init_op(new_op);
 			new_op->ops_size = W6_OPS_SIZE;
 
@@ -802,7 +1465,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 			new_op->ops[4] = opfXXRL;
 			return createW6Op(new_op);
 		} else {
-			operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+			operation_t* new_op = alloc_op();
 			init_op(new_op);
 			new_op->ops_size = PUSHUP_OPS_SIZE;
 
@@ -821,7 +1484,7 @@ volatile operation_t* create_overweight_left_op(volatile node_t* f,
 		volatile operation_t* opfXXR = weak_llx(fXXR);
 		if (opfXXR == null)
 			return null;
-		operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+		operation_t* new_op = alloc_op();
 		init_op(new_op);
 
 		new_op->ops_size = W7_OPS_SIZE;
@@ -853,7 +1516,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 					volatile operation_t* opfXL = weak_llx(fXL);
 					if (opfXL == null)
 						return null;
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = BLK_OPS_SIZE;
 
@@ -871,7 +1534,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 					volatile operation_t* opfXXL = weak_llx(fXXL);
 					if (opfXXL == null)
 						return null;
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = RB2SYM_OPS_SIZE;
 
@@ -891,7 +1554,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 					volatile operation_t* opfXR = weak_llx(fXR);
 					if (opfXR == null)
 						return null;
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = BLK_OPS_SIZE;
 
@@ -906,7 +1569,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 					new_op->ops[3] = opfXR;
 					return createBlkOp(new_op);
 				} else {
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 					new_op->ops_size = RB1_OPS_SIZE;
 
@@ -931,7 +1594,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 				return null;
 
 			if (fXXLR->weight > 1) {
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = W1SYM_OPS_SIZE;
 
@@ -948,7 +1611,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 				new_op->ops[4] = opfXXLR;
 				return createW1SymOp(new_op);
 			} else if (fXXLR->weight == 0) {
-				operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+				operation_t* new_op = alloc_op();
 				init_op(new_op);
 				new_op->ops_size = RB2_OPS_SIZE;
 
@@ -970,7 +1633,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 					volatile operation_t* opfXXLRL = weak_llx(fXXLRL);
 					if (opfXXLRL == null)
 						return null;
-					operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+					operation_t* new_op = alloc_op();
 					init_op(new_op);
 
 					new_op->ops_size = W4SYM_OPS_SIZE;
@@ -998,7 +1661,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 						if (opfXXLRR == null)
 							return null;
 
-						operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+						operation_t* new_op = alloc_op();
 						init_op(new_op);
 						new_op->ops_size = W3SYM_OPS_SIZE;
 
@@ -1017,7 +1680,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 						new_op->ops[5] = opfXXLRR;
 						return createW3SymOp(new_op);
 					} else { // assert: fXXLRR->weight > 0
-						operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+						operation_t* new_op = alloc_op();
 						init_op(new_op);
 						new_op->ops_size = W2SYM_OPS_SIZE;
 
@@ -1050,7 +1713,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 			volatile operation_t* opfXXLL = weak_llx(fXXLL);
 			if (opfXXLL == null)
 				return null;
-			operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+			operation_t* new_op = alloc_op();
 			init_op(new_op);
 			new_op->ops_size = W5SYM_OPS_SIZE;
 
@@ -1070,7 +1733,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 			volatile operation_t* opfXXLR = weak_llx(fXXLR);
 			if (opfXXLR == null)
 				return null;
-			operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+			operation_t* new_op = alloc_op();
 			init_op(new_op);
 			new_op->ops_size = W6SYM_OPS_SIZE;
 
@@ -1087,7 +1750,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 			new_op->ops[4] = opfXXLR;
 			return createW6SymOp(new_op);
 		} else {
-			operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+			operation_t* new_op = alloc_op();
 			init_op(new_op);
 			new_op->ops_size = PUSHUPSYM_OPS_SIZE;
 
@@ -1106,7 +1769,7 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 		volatile operation_t* opfXXL = weak_llx(fXXL);
 		if (opfXXL == null)
 			return null;
-		operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+		operation_t* new_op = alloc_op();
 		init_op(new_op);
 		new_op->ops_size = W7SYM_OPS_SIZE;
 
@@ -1125,10 +1788,11 @@ volatile operation_t* create_overweight_right_op(volatile node_t* f,
 }
 
 volatile operation_t* createBlkOp(volatile operation_t* new_op) {
+	STAT_INC(rebalance[REBALANCE_BLK]);
 
-	node_t* nodeXL = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeXR = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXL = alloc_node();
+	node_t* nodeXR = alloc_node();
+	node_t* nodeX = alloc_node();
 
 	if (init_node(nodeXL, new_op->nodes[2]->key,1, new_op->nodes[2]->left,
 			new_op->nodes[2]->right, dummy))
@@ -1148,8 +1812,9 @@ volatile operation_t* createBlkOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createRb1Op(volatile operation_t* new_op) {
-	node_t* nodeXR = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeX = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_RB1]);
+	node_t* nodeXR = alloc_node();
+	node_t* nodeX = alloc_node();
 
 	if (init_node(nodeXR, new_op->nodes[1]->key, 0, new_op->nodes[2]->right,
 			new_op->nodes[1]->right, dummy))
@@ -1168,9 +1833,10 @@ volatile operation_t* createRb1Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createRb2Op(volatile operation_t* new_op) {
-	node_t* nodeXL = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeXR = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeX = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_RB2]);
+	node_t* nodeXL = alloc_node();
+	node_t* nodeXR = alloc_node();
+	node_t* nodeX = alloc_node();
 
 	if (init_node(nodeXL, new_op->nodes[2]->key, 0, new_op->nodes[2]->left,
 			new_op->nodes[3]->left, dummy))
@@ -1192,8 +1858,9 @@ volatile operation_t* createRb2Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createRb1SymOp(volatile operation_t* new_op) {
-	node_t* nodeXL = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeX = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_RB1]);
+	node_t* nodeXL = alloc_node();
+	node_t* nodeX = alloc_node();
 
 	if (init_node(nodeXL, new_op->nodes[1]->key, 0, new_op->nodes[1]->left,
 			new_op->nodes[2]->left, dummy))
@@ -1211,9 +1878,10 @@ volatile operation_t* createRb1SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createRb2SymOp(volatile operation_t* new_op) {
-	node_t* nodeXL = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeXR = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeX = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_RB2]);
+	node_t* nodeXL = alloc_node();
+	node_t* nodeXR = alloc_node();
+	node_t* nodeX = alloc_node();
 
 	if (init_node(nodeXL, new_op->nodes[1]->key, 0, new_op->nodes[1]->left,
 			new_op->nodes[3]->left, dummy))
@@ -1235,10 +1903,11 @@ volatile operation_t* createRb2SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW1Op(volatile operation_t* new_op) {
-	node_t* nodeXXLL = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeXXLR = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W1]);
+	node_t* nodeXXLL = alloc_node();
+	node_t* nodeXXLR = alloc_node();
+	node_t* nodeXXL = alloc_node();
+	node_t* nodeXX = alloc_node();
 
 	if (init_node(nodeXXLL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
@@ -1264,25 +1933,26 @@ volatile operation_t* createW1Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW2Op(volatile operation_t* new_op) {
+	STAT_INC(rebalance[REBALANCE_W2]);
 
-	node_t* nodeXXLL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXLL = alloc_node();
 	if (init_node(nodeXXLL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXLR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXLR = alloc_node();
 	if (init_node(nodeXXLR, new_op->nodes[4]->key, 0, new_op->nodes[4]->left,
 			new_op->nodes[4]->right, dummy))
 		return null;
 
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[1]->key, 1, nodeXXLL,
 			nodeXXLR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[3]->key, weight, nodeXXL,
 			new_op->nodes[3]->right, dummy))
 		return null;
@@ -1293,29 +1963,30 @@ volatile operation_t* createW2Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW3Op(volatile operation_t* new_op) {
-	node_t* nodeXXLLL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W3]);
+	node_t* nodeXXLLL = alloc_node();
 	if (init_node(nodeXXLLL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXLL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXLL = alloc_node();
 	if (init_node(nodeXXLL, new_op->nodes[1]->key, 1, nodeXXLLL,
 			new_op->nodes[5]->left, dummy))
 		return null;
 
-	node_t* nodeXXLR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXLR = alloc_node();
 	if (init_node(nodeXXLR, new_op->nodes[4]->key, 1, new_op->nodes[5]->right,
 			new_op->nodes[4]->right, dummy))
 		return null;
 
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[5]->key, 0, nodeXXLL,
 			nodeXXLR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[3]->key, weight, nodeXXL,
 			new_op->nodes[3]->right, dummy))
 		return null;
@@ -1326,29 +1997,30 @@ volatile operation_t* createW3Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW4Op(volatile operation_t* new_op) {
-	node_t* nodeXXLL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W4]);
+	node_t* nodeXXLL = alloc_node();
 	if (init_node(nodeXXLL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[1]->key, 1, nodeXXLL,
 			new_op->nodes[4]->left, dummy))
 		return null;
 
-	node_t* nodeXXRL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRL = alloc_node();
 	if (init_node(nodeXXRL, new_op->nodes[5]->key, 1, new_op->nodes[5]->left,
 			new_op->nodes[5]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[3]->key, 0, nodeXXRL,
 			new_op->nodes[3]->right, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[4]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1358,24 +2030,25 @@ volatile operation_t* createW4Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW5Op(volatile operation_t* new_op) {
-	node_t* nodeXXLL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W5]);
+	node_t* nodeXXLL = alloc_node();
 	if (init_node(nodeXXLL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[1]->key, 1, nodeXXLL,
 			new_op->nodes[3]->left, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[4]->key, 1, new_op->nodes[4]->left,
 			new_op->nodes[4]->right, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[3]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1385,24 +2058,25 @@ volatile operation_t* createW5Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW6Op(volatile operation_t* new_op) {
-	node_t* nodeXXLL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W6]);
+	node_t* nodeXXLL = alloc_node();
 	if (init_node(nodeXXLL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[1]->key, 1, nodeXXLL,
 			new_op->nodes[4]->left, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[3]->key, 1, new_op->nodes[4]->right,
 			new_op->nodes[3]->right, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[4]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1413,19 +2087,20 @@ volatile operation_t* createW6Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW7Op(volatile operation_t* new_op) {
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W7]);
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
 	const int weight = is_sentinel(new_op->nodes[1]) ? 1 : new_op->nodes[1]->weight + 1;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[1]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1436,24 +2111,25 @@ volatile operation_t* createW7Op(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW1SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXRL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W1]);
+	node_t* nodeXXRL = alloc_node();
 	if (init_node(nodeXXRL, new_op->nodes[4]->key,
 			new_op->nodes[4]->weight - 1, new_op->nodes[4]->left, new_op->nodes[4]->right, dummy))
 		return null;
 
-	node_t* nodeXXRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRR = alloc_node();
 	if (init_node(nodeXXRR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[1]->key, 1, nodeXXRL,
 			nodeXXRR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[2]->key, weight,
 			new_op->nodes[2]->left, nodeXXR, dummy))
 		return null;
@@ -1463,24 +2139,25 @@ volatile operation_t* createW1SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW2SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXRL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W2]);
+	node_t* nodeXXRL = alloc_node();
 	if (init_node(nodeXXRL, new_op->nodes[4]->key, 0, new_op->nodes[4]->left,
 			new_op->nodes[4]->right, dummy))
 		return null;
 
-	node_t* nodeXXRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRR = alloc_node();
 	if (init_node(nodeXXRR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[1]->key, 1, nodeXXRL,
 			nodeXXRR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[2]->key, weight,
 			new_op->nodes[2]->left, nodeXXR, dummy))
 		return null;
@@ -1490,29 +2167,30 @@ volatile operation_t* createW2SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW3SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXRL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W3]);
+	node_t* nodeXXRL = alloc_node();
 	if (init_node(nodeXXRL, new_op->nodes[4]->key, 1, new_op->nodes[4]->left,
 			new_op->nodes[5]->left, dummy))
 		return null;
 
-	node_t* nodeXXRRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRRR = alloc_node();
 	if (init_node(nodeXXRRR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
-	node_t* nodeXXRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRR = alloc_node();
 	if (init_node(nodeXXRR, new_op->nodes[1]->key, 1, new_op->nodes[5]->right,
 			nodeXXRRR, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[5]->key, 0, nodeXXRL,
 			nodeXXRR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[2]->key, weight,
 			new_op->nodes[2]->left, nodeXXR, dummy))
 		return null;
@@ -1522,29 +2200,30 @@ volatile operation_t* createW3SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW4SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXLR = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W4]);
+	node_t* nodeXXLR = alloc_node();
 	if (init_node(nodeXXLR, new_op->nodes[5]->key, 1, new_op->nodes[5]->left,
 			new_op->nodes[5]->right, dummy))
 		return null;
 
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[2]->key, 0, new_op->nodes[2]->left,
 			nodeXXLR, dummy))
 		return null;
 
-	node_t* nodeXXRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRR = alloc_node();
 	if (init_node(nodeXXRR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[1]->key, 1, new_op->nodes[4]->right,
 			nodeXXRR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[4]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1554,24 +2233,25 @@ volatile operation_t* createW4SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW5SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W5]);
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[4]->key, 1, new_op->nodes[4]->left,
 			new_op->nodes[4]->right, dummy))
 		return null;
 
-	node_t* nodeXXRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRR = alloc_node();
 	if (init_node(nodeXXRR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[1]->key, 1, new_op->nodes[2]->right,
 			nodeXXRR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[2]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1582,24 +2262,25 @@ volatile operation_t* createW5SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW6SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W6]);
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[2]->key, 1, new_op->nodes[2]->left,
 			new_op->nodes[4]->left, dummy))
 		return null;
 
-	node_t* nodeXXRR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXRR = alloc_node();
 	if (init_node(nodeXXRR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[1]->key, 1, new_op->nodes[4]->right,
 			nodeXXRR, dummy))
 		return null;
 
 	const int weight = new_op->nodes[1]->weight;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[4]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1610,19 +2291,20 @@ volatile operation_t* createW6SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createW7SymOp(volatile operation_t* new_op) {
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_W7]);
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
 	const int weight = is_sentinel(new_op->nodes[1]) ? 1 : new_op->nodes[1]->weight + 1;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[1]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1633,19 +2315,20 @@ volatile operation_t* createW7SymOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createPushOp(volatile operation_t* new_op) {
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_PUSH]);
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[2]->key,
 			new_op->nodes[2]->weight - 1, new_op->nodes[2]->left, new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[3]->key, 0, new_op->nodes[3]->left,
 			new_op->nodes[3]->right, dummy))
 		return null;
 
 	const int weight = is_sentinel(new_op->nodes[1]) ? 1 : new_op->nodes[1]->weight + 1;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[1]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1655,19 +2338,20 @@ volatile operation_t* createPushOp(volatile operation_t* new_op) {
 }
 
 volatile operation_t* createPushSymOp(volatile operation_t* new_op) {
-	node_t* nodeXXL = (node_t*) xmalloc(sizeof(node_t));
+	STAT_INC(rebalance[REBALANCE_PUSH]);
+	node_t* nodeXXL = alloc_node();
 	if (init_node(nodeXXL, new_op->nodes[2]->key, 0, new_op->nodes[2]->left,
 			new_op->nodes[2]->right, dummy))
 		return null;
 
-	node_t* nodeXXR = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXXR = alloc_node();
 	if (init_node(nodeXXR, new_op->nodes[3]->key,
 			new_op->nodes[3]->weight - 1, new_op->nodes[3]->left, new_op->nodes[3]->right, dummy))
 		return null;
 
 	const int weight = is_sentinel(new_op->nodes[1]) ? 1 : new_op->nodes[1]->weight + 1;
 
-	node_t* nodeXX = (node_t*) xmalloc(sizeof(node_t));
+	node_t* nodeXX = alloc_node();
 	if (init_node(nodeXX, new_op->nodes[1]->key, weight, nodeXXL,
 			nodeXXR, dummy))
 		return null;
@@ -1694,3 +2378,110 @@ int height_node(volatile node_t* node) {
 		return left_height > right_height ? left_height + 1 : right_height + 1;
 	}
 }
+
+// violations are those on the path down to node
+void stats_node(stats_stack_t* stack, volatile node_t* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s) {
+	volatile node_t* left = node->left;
+	volatile node_t* right = node->right;
+	const unsigned long weight = node->weight;
+	stats_gap(s, weight);
+	const unsigned long here = violations + (weight > 1 ? weight - 1 : 0);
+	if (weight > 1)
+		stats_violation(s, depth, weight - 1); // overweight
+	if (!left) {
+		stats_leaf(s, depth, here);
+		return;
+	}
+	s->internal++;
+	unsigned long below[2] = { here, here };
+	if (weight == 0) {
+		if (left->weight == 0) {
+			stats_violation(s, depth + 1, 1); // red-red
+			below[0]++;
+		}
+		if (right && right->weight == 0) {
+			stats_violation(s, depth + 1, 1);
+			below[1]++;
+		}
+	}
+	if (right)
+		stats_push(stack, right, depth + 1, below[1]);
+	stats_push(stack, left, depth + 1, below[0]);
+}
+
+void stats_walk(stats_stack_t* stack, volatile void* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s) {
+	stats_push(stack, node, depth, violations);
+	while (stack->size) {
+		const stats_entry_t e = stack->entries[--stack->size];
+		stats_node(stack, (volatile node_t*) e.node, e.depth, e.violations, s);
+	}
+}
+
+void tree_stats(tree_stats_t* s, const int nthreads) {
+	volatile node_t* top = root->left->left;
+	if (!top)
+		return;
+	stats_stack_t frontier = { NULL, 0, 0 };
+	stats_push(&frontier, top, 1, 0);
+	// expand the top of the tree breadth-first until every thread has
+	// several subtrees to walk
+	while (nthreads > 1 && frontier.size < nthreads * STATS_SPLIT_FACTOR) {
+		stats_stack_t next = { NULL, 0, 0 };
+		bool expanded = false;
+		for (int i = 0; i < frontier.size; ++i) {
+			volatile node_t* node = (volatile node_t*) frontier.entries[i].node;
+			if (node->left) {
+				stats_node(&next, node, frontier.entries[i].depth,
+						frontier.entries[i].violations, s);
+				expanded = true;
+			} else {
+				stats_push(&next, node, frontier.entries[i].depth,
+						frontier.entries[i].violations);
+			}
+		}
+		free(frontier.entries);
+		frontier = next;
+		if (!expanded)
+			break;
+	}
+	stats_run(&frontier, nthreads > 1 ? nthreads : 1, stats_walk, s);
+	free(frontier.entries);
+}
+
+// walks every node reachable from the root, sentinels included
+void tree_footprint(mem_footprint_t* m) {
+	stats_stack_t stack = { NULL, 0, 0 };
+	unsigned long* ops = NULL;
+	unsigned long nb_ops = 0, capacity = 0;
+	m->nodes = 0;
+	m->node_size = sizeof(node_t);
+	m->op_size = sizeof(operation_t);
+	stats_push(&stack, root, 0, 0);
+	while (stack.size) {
+		volatile node_t* node = (volatile node_t*) stack.entries[--stack.size].node;
+		m->nodes++;
+		if (nb_ops == capacity) {
+			capacity = capacity ? 2 * capacity : 1024;
+			ops = (unsigned long*) realloc(ops, capacity * sizeof(unsigned long));
+			if (!ops) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		ops[nb_ops++] = (unsigned long) node->op;
+		if (node->left)
+			stats_push(&stack, node->left, 0, 0);
+		if (node->right)
+			stats_push(&stack, node->right, 0, 0);
+	}
+	m->ops = mem_distinct(ops, nb_ops);
+	m->bytes = m->nodes * m->node_size + m->ops * m->op_size;
+	m->aux_bytes = (modes & MODE_CACHE ? sizeof(cache_t) : 0)
+			+ (modes & MODE_BLOOM ? bloom_bytes(&bloom) : 0);
+	free(ops);
+	free(stack.entries);
+}
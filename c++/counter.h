@@ -0,0 +1,108 @@
+/*
+ * counter.h
+ *
+ *  Striped count of the keys in a set. Every successful insert/delete
+ *  adds its +1/-1 to the stripe of its thread once it is done, so size()
+ *  costs one read per stripe instead of a walk of the set; it lags the
+ *  set by the updates in progress. In MODE_SIZE updates also register in
+ *  their stripe while they run, and counter_exact holds off new updates,
+ *  waits until the registered ones left and sums: nothing is in progress
+ *  at that point, so the sum is the size of the set at that instant.
+ *  snapshot.h starts its snapshots the same way.
+ */
+
+#ifndef COUNTER_H_
+#define COUNTER_H_
+
+#include "atomic_ops.h"
+
+#define COUNTER_STRIPES			128  // power of 2, threads beyond share stripes
+#define COUNTER_LINE			64
+
+typedef struct counter_stripe {
+	volatile long keys;
+	volatile unsigned long busy; // registered updates in progress
+	char pad[COUNTER_LINE - 2 * sizeof(long)];
+} __attribute__((aligned(COUNTER_LINE))) counter_stripe_t;
+
+typedef struct counter {
+	counter_stripe_t stripes[COUNTER_STRIPES];
+	volatile unsigned long frozen; // counter_freeze calls holding off updates
+	volatile int next_id;          // stripes handed out in this epoch
+	volatile int epoch;            // bumped by counter_reset
+} counter_t;
+
+static __thread int counter_id = -1;
+static __thread int counter_epoch = -1;
+
+// a new set: all stripes zero and handed out again from 0
+static inline void counter_reset(counter_t* c) {
+	for (int i = 0; i < COUNTER_STRIPES; ++i) {
+		c->stripes[i].keys = 0;
+		c->stripes[i].busy = 0;
+	}
+	c->frozen = 0;
+	c->next_id = 0;
+	c->epoch++;
+}
+
+static inline counter_stripe_t* counter_stripe(counter_t* c) {
+	if (counter_epoch != c->epoch) {
+		counter_epoch = c->epoch;
+		counter_id = __sync_fetch_and_add(&c->next_id, 1);
+	}
+	return &c->stripes[counter_id & (COUNTER_STRIPES - 1)];
+}
+
+static inline void counter_add(counter_t* c, const long delta) {
+	AO_fetch_and_add((AO_t*) &counter_stripe(c)->keys, (AO_t) delta);
+}
+
+// registers an update, after any counter_freeze in progress (MODE_SIZE,
+// MODE_SNAPSHOT)
+static inline void counter_enter(counter_t* c) {
+	counter_stripe_t* s = counter_stripe(c);
+	while (true) {
+		AO_fetch_and_add_full((AO_t*) &s->busy, 1); // ordered before frozen
+		if (!c->frozen)
+			return;
+		AO_fetch_and_add_full((AO_t*) &s->busy, (AO_t) -1);
+		while (c->frozen)
+			;
+	}
+}
+
+static inline void counter_leave(counter_t* c) {
+	AO_fetch_and_add_full((AO_t*) &counter_stripe(c)->busy, (AO_t) -1);
+}
+
+// the sum of the stripes, without waiting
+static inline long counter_sum(counter_t* c) {
+	long keys = 0;
+	for (int i = 0; i < COUNTER_STRIPES; ++i)
+		keys += c->stripes[i].keys;
+	return keys > 0 ? keys : 0;
+}
+
+// holds off new registered updates and waits until the ones in progress
+// left; nothing registered runs until counter_thaw
+static inline void counter_freeze(counter_t* c) {
+	AO_fetch_and_add_full((AO_t*) &c->frozen, 1);
+	for (int i = 0; i < COUNTER_STRIPES; ++i)
+		while (c->stripes[i].busy)
+			;
+}
+
+static inline void counter_thaw(counter_t* c) {
+	AO_fetch_and_add_full((AO_t*) &c->frozen, (AO_t) -1);
+}
+
+// the size at one instant, if the updates register (MODE_SIZE)
+static inline long counter_exact(counter_t* c) {
+	counter_freeze(c);
+	const long keys = counter_sum(c);
+	counter_thaw(c);
+	return keys;
+}
+
+#endif /* COUNTER_H_ */
@@ -0,0 +1,121 @@
+/*
+ * elim.h
+ *
+ *  Elimination of insert/delete pairs on the same key. An update that
+ *  found it would change the set (insert of an absent key, delete of a
+ *  present one) offers itself in the slot of its key and spins for a
+ *  while. An update of the other kind on the same key that finds the
+ *  offer matches it, and the offerer checks that the leaf it found is
+ *  still in the tree: the key was then absent (present) throughout, so
+ *  the pair is linearized at the match as insert then delete (delete
+ *  then insert) and both return true without touching the tree.
+ *
+ *  Slot state word: seq << 4 | type << 3 | status; seq changes whenever
+ *  a slot is freed, so a stale match cannot succeed.
+ */
+
+#ifndef ELIM_H_
+#define ELIM_H_
+
+#include <stdlib.h>
+#include "atomic_ops.h"
+
+#define ELIM_SLOTS				64   // power of 2
+#define ELIM_SPINS				256  // polls of an offer before it is withdrawn
+#define ELIM_LINE				64
+
+#define ELIM_INSERT				0
+#define ELIM_DELETE				1
+
+#define ELIM_EMPTY				0
+#define ELIM_BUSY				1    // the offerer is writing the key
+#define ELIM_WAITING			2
+#define ELIM_MATCHED			3
+#define ELIM_OK					4    // the offerer's leaf was still valid
+#define ELIM_FAIL				5
+
+#define ELIM_WORD(seq, type, status)	(((seq) << 4) | ((type) << 3) | (status))
+#define ELIM_SEQ(w)				((w) >> 4)
+#define ELIM_TYPE(w)			(((w) >> 3) & 1)
+#define ELIM_STATUS(w)			((w) & 7)
+
+typedef struct elim_slot {
+	volatile unsigned long state;
+	volatile unsigned long key;
+	char pad[ELIM_LINE - 2 * sizeof(unsigned long)];
+} __attribute__((aligned(ELIM_LINE))) elim_slot_t;
+
+typedef struct elim_array {
+	elim_slot_t slots[ELIM_SLOTS];
+} elim_array_t;
+
+static inline elim_slot_t* elim_slot(elim_array_t* a, const unsigned long key) {
+	unsigned long h = key * 0x9E3779B97F4A7C15UL;
+	return &a->slots[(h >> 32) & (ELIM_SLOTS - 1)];
+}
+
+static inline bool elim_cas(volatile unsigned long* p, const unsigned long old,
+		const unsigned long new) {
+	return AO_compare_and_swap((AO_t*) p, (AO_t) old, (AO_t) new);
+}
+
+// frees a slot for the next offer
+static inline void elim_release(elim_slot_t* s, const unsigned long w) {
+	s->state = ELIM_WORD(ELIM_SEQ(w) + 1, 0, ELIM_EMPTY);
+}
+
+/*
+ * Matches an offer of the other kind for key. Returns true if the offerer
+ * confirmed it, in which case the caller's update is done.
+ */
+static inline bool elim_take(elim_array_t* a, const unsigned long key,
+		const int type) {
+	elim_slot_t* s = elim_slot(a, key);
+	const unsigned long w = s->state;
+	if (ELIM_STATUS(w) != ELIM_WAITING || ELIM_TYPE(w) == type
+			|| s->key != key)
+		return false;
+	const unsigned long matched = ELIM_WORD(ELIM_SEQ(w), ELIM_TYPE(w),
+			ELIM_MATCHED);
+	if (!elim_cas(&s->state, w, matched))
+		return false;
+	unsigned long answer;
+	while ((answer = s->state) == matched)
+		;
+	elim_release(s, answer);
+	return ELIM_STATUS(answer) == ELIM_OK;
+}
+
+/*
+ * Offers an update of key and spins for a partner. Returns the slot if
+ * one matched; the caller then validates what it found and answers with
+ * elim_answer. Returns NULL if the slot was taken or nobody came.
+ */
+static inline elim_slot_t* elim_offer(elim_array_t* a, const unsigned long key,
+		const int type) {
+	elim_slot_t* s = elim_slot(a, key);
+	const unsigned long w = s->state;
+	if (ELIM_STATUS(w) != ELIM_EMPTY)
+		return NULL;
+	const unsigned long seq = ELIM_SEQ(w);
+	if (!elim_cas(&s->state, w, ELIM_WORD(seq, type, ELIM_BUSY)))
+		return NULL;
+	s->key = key;
+	const unsigned long waiting = ELIM_WORD(seq, type, ELIM_WAITING);
+	s->state = waiting;
+	for (int i = 0; i < ELIM_SPINS; ++i)
+		if (s->state != waiting)
+			return s;
+	if (elim_cas(&s->state, waiting, ELIM_WORD(seq + 1, 0, ELIM_EMPTY)))
+		return NULL; // withdrawn
+	return s;
+}
+
+// the offerer's verdict; the matcher frees the slot once it has read it
+static inline void elim_answer(elim_slot_t* s, const bool valid) {
+	const unsigned long w = s->state;
+	s->state = ELIM_WORD(ELIM_SEQ(w), ELIM_TYPE(w),
+			valid ? ELIM_OK : ELIM_FAIL);
+}
+
+#endif /* ELIM_H_ */
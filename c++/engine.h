@@ -0,0 +1,63 @@
+/*
+ * engine.h
+ *
+ *  Function table through which the benchmark driver (bench/) runs a
+ *  set implementation. The trees are built as partially linked objects
+ *  that only export their engine_t (see ravl/Makefile), so engines with
+ *  the same function and variable names can share one binary.
+ */
+
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include "scx_stats.h"
+#include "tree_stats.h"
+#include "mem_stats.h"
+#include "modes.h"
+
+typedef struct engine {
+	const char* name;       // CSV prefix and --engine name
+	bool violations;        // honours the number of violations d
+	int (*init)(const int violations); // (re)creates an empty set
+	bool (*get)(const unsigned long key);
+	bool (*insert)(const unsigned long key);
+	bool (*delete)(const unsigned long key);
+	int (*height)();
+	int (*size)();
+	// the calling thread's fix_to_key time in ticks, null if not measured
+	unsigned long* (*fix_ticks)();
+	// copies the calling thread's LLX/SCX counters, null if not counted
+	void (*scx_stats)(scx_stats_t* s);
+	// shape statistics (tree_stats.h), null if not implemented
+	void (*tree_stats)(tree_stats_t* s, const int nthreads);
+	const char** rebalance_names;      // null terminated, for scx_stats_print
+	const char* const* gap_name;       // stats_gap_name of the tree
+	// copies the calling thread's allocation counters, null if not counted
+	void (*mem_stats)(mem_stats_t* s);
+	// what is reachable when quiescent, null if not implemented
+	void (*footprint)(mem_footprint_t* m);
+	int modes;                         // MODE_* flags it implements
+	void (*set_modes)(const int modes); // before init, null if modes is 0
+	// keys the set is expected to hold and the largest key, before init;
+	// null if not used
+	void (*reserve)(const unsigned long keys, const unsigned long range);
+	// keys smaller than key, and the key with i smaller ones; exact when
+	// quiescent in MODE_RANK, null if not implemented
+	unsigned long (*rank)(const unsigned long key);
+	bool (*select)(const unsigned long i, unsigned long* key);
+	// calls visit on the keys in [lo, hi] in order and returns their
+	// number; those of one instant in MODE_SNAPSHOT, null if not implemented
+	unsigned long (*scan)(const unsigned long lo, const unsigned long hi,
+			void (*visit)(const unsigned long key, void* arg), void* arg);
+	// removes the keys in [lo, hi] and returns their number, null if not
+	// implemented
+	unsigned long (*delete_range)(const unsigned long lo, const unsigned long hi);
+} engine_t;
+
+extern const engine_t ravl_engine;
+extern const engine_t chromatic_engine;
+extern const engine_t rbtree_engine;
+extern const engine_t skiplist_engine;
+extern const engine_t empty_engine;
+
+#endif /* ENGINE_H_ */
@@ -0,0 +1,144 @@
+/*
+ * fc.h
+ *
+ *  Flat combining for updates that keep losing their SCX. The key range
+ *  given to fc_reset is cut into FC_DOMAINS contiguous slices, so a
+ *  domain stands for the subtrees holding one slice of the keys. A
+ *  thread whose recent conflict rate passed FC_THRESHOLD publishes its
+ *  update in its slot of the key's domain and spins until it is applied;
+ *  whoever takes the domain lock sorts the pending updates by key and
+ *  applies them one after the other with the ordinary insert/delete.
+ *  This is a blocking serializer per domain: the batch costs as many SCXs
+ *  as its updates, and what it saves is the retries of threads that
+ *  would otherwise fight over the same nodes.
+ */
+
+#ifndef FC_H_
+#define FC_H_
+
+#include <limits.h>
+#include <stdlib.h>
+#include "atomic_ops.h"
+
+#define FC_DOMAINS				16
+#define FC_MAX_THREADS			128  // later threads never combine
+#define FC_CONFLICT				16   // added to the contention of a thread per conflict
+#define FC_THRESHOLD			64   // about one conflict in four updates
+#define FC_LINE					64
+
+#define FC_INSERT				1
+#define FC_DELETE				2
+
+typedef struct fc_request {
+	volatile int op;            // FC_INSERT or FC_DELETE while pending, 0 once applied
+	volatile bool result;
+	volatile unsigned long key;
+	char pad[FC_LINE - 2 * sizeof(unsigned long)];
+} __attribute__((aligned(FC_LINE))) fc_request_t;
+
+typedef struct fc_domain {
+	volatile unsigned long lock;
+	char pad[FC_LINE - sizeof(unsigned long)];
+	fc_request_t requests[FC_MAX_THREADS];
+} fc_domain_t;
+
+typedef struct fc_array {
+	fc_domain_t domains[FC_DOMAINS];
+	unsigned long width;        // keys per domain, see fc_domain
+	volatile int next_id;       // slots handed out in this epoch
+	volatile int epoch;         // bumped by fc_reset
+} fc_array_t;
+
+typedef bool (*fc_update_fn)(const unsigned long key);
+
+static __thread int fc_id = -1;
+static __thread int fc_id_epoch = -1;
+static __thread unsigned int fc_contention = 0;
+static __thread bool fc_combining = false; // applying a batch, bypass combining
+
+// a new tree with keys up to range (0 if not known): slots are handed
+// out again from 0
+static inline void fc_reset(fc_array_t* a, const unsigned long range) {
+	a->next_id = 0;
+	a->epoch++;
+	if (!range)
+		a->width = ULONG_MAX / FC_DOMAINS + 1;
+	else
+		a->width = range >= FC_DOMAINS ? range / FC_DOMAINS : 1;
+}
+
+// the domain of the slice of the key range that holds key
+static inline fc_domain_t* fc_domain(fc_array_t* a, const unsigned long key) {
+	const unsigned long i = key / a->width;
+	return &a->domains[i < FC_DOMAINS ? i : FC_DOMAINS - 1];
+}
+
+static inline void fc_conflict() {
+	fc_contention += FC_CONFLICT;
+}
+
+// decays the contention of the thread; true if it should combine
+static inline bool fc_contended() {
+	if (fc_combining)
+		return false;
+	fc_contention -= fc_contention >> 4;
+	return fc_contention >= FC_THRESHOLD;
+}
+
+static inline int fc_thread_id(fc_array_t* a) {
+	if (fc_id_epoch != a->epoch) {
+		fc_id_epoch = a->epoch;
+		fc_id = __sync_fetch_and_add(&a->next_id, 1);
+	}
+	return fc_id;
+}
+
+static int fc_request_cmp(const void* x, const void* y) {
+	const unsigned long a = (*(fc_request_t* const*) x)->key;
+	const unsigned long b = (*(fc_request_t* const*) y)->key;
+	return a < b ? -1 : a > b;
+}
+
+// applies the pending updates of d in key order; the caller holds d->lock
+static inline void fc_combine(fc_domain_t* d, const int nslots,
+		fc_update_fn insert, fc_update_fn delete) {
+	fc_request_t* batch[FC_MAX_THREADS];
+	int n = 0;
+	for (int i = 0; i < nslots; ++i)
+		if (d->requests[i].op)
+			batch[n++] = &d->requests[i];
+	qsort(batch, n, sizeof(fc_request_t*), fc_request_cmp);
+	fc_combining = true;
+	for (int i = 0; i < n; ++i) {
+		fc_request_t* r = batch[i];
+		r->result = r->op == FC_INSERT ? insert(r->key) : delete(r->key);
+		r->op = 0;
+	}
+	fc_combining = false;
+}
+
+/*
+ * Publishes an update of key and waits until a combiner applied it,
+ * combining itself whenever the domain lock is free.
+ */
+static inline bool fc_apply(fc_array_t* a, const unsigned long key,
+		const int op, fc_update_fn insert, fc_update_fn delete) {
+	const int id = fc_thread_id(a);
+	if (id >= FC_MAX_THREADS)
+		return op == FC_INSERT ? insert(key) : delete(key);
+	fc_domain_t* d = fc_domain(a, key);
+	fc_request_t* r = &d->requests[id];
+	r->key = key;
+	r->op = op;
+	while (r->op) {
+		if (!d->lock && AO_compare_and_swap((AO_t*) &d->lock, 0, 1)) {
+			const int nslots = a->next_id;
+			fc_combine(d, nslots < FC_MAX_THREADS ? nslots : FC_MAX_THREADS,
+					insert, delete);
+			d->lock = 0;
+		}
+	}
+	return r->result;
+}
+
+#endif /* FC_H_ */
@@ -0,0 +1,49 @@
+/*
+ * finger.h
+ *
+ *  Finger search: each thread keeps the internal nodes of its last search
+ *  path with the key interval routed through each of them, so the next
+ *  search can start from the deepest one that covers its key. A node
+ *  that is not marked is still in the tree, and the interval of a node
+ *  that stays in the tree only grows (a delete moves the sibling up,
+ *  rebalancing replaces the nodes above it by copies), so such an entry
+ *  is a valid place to start. The trees check marked before starting.
+ */
+
+#ifndef FINGER_H_
+#define FINGER_H_
+
+#define FINGER_MAX_DEPTH		128 // deeper nodes are not remembered
+
+typedef struct finger_entry {
+	volatile void* node;
+	unsigned long lo;           // keys in [lo, hi) are routed through node
+	unsigned long hi;
+	int count;                  // violations counted down to node
+} finger_entry_t;
+
+typedef struct finger {
+	finger_entry_t path[FINGER_MAX_DEPTH];
+	int depth;
+} finger_t;
+
+static inline void finger_push(finger_t* f, volatile void* node,
+		const unsigned long lo, const unsigned long hi, const int count) {
+	if (f->depth == FINGER_MAX_DEPTH)
+		return;
+	finger_entry_t* e = &f->path[f->depth++];
+	e->node = node;
+	e->lo = lo;
+	e->hi = hi;
+	e->count = count;
+}
+
+// deepest entry whose interval covers key, -1 if none
+static inline int finger_find(const finger_t* f, const unsigned long key) {
+	int i = f->depth - 1;
+	while (i >= 0 && (key < f->path[i].lo || key >= f->path[i].hi))
+		--i;
+	return i;
+}
+
+#endif /* FINGER_H_ */
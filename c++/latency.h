@@ -0,0 +1,214 @@
+/*
+ * latency.h
+ *
+ *  Per-thread log-linear (HDR style) latency histograms for the harness.
+ *  Values are recorded in TSC ticks and converted to nanoseconds when the
+ *  report is printed.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LAT_GET					0
+#define LAT_INSERT_OK			1
+#define LAT_INSERT_FAIL			2
+#define LAT_DELETE_OK			3
+#define LAT_DELETE_FAIL			4
+#define LAT_FIX					5
+#define LAT_NUM_TYPES			6
+
+// 2^LAT_SUB_BITS linear sub-buckets below the first power of two, then
+// 2^(LAT_SUB_BITS-1) sub-buckets per power of two: ~3% relative error.
+#define LAT_SUB_BITS			6
+#define LAT_SUB_COUNT			(1UL << LAT_SUB_BITS)
+#define LAT_HALF_COUNT			(LAT_SUB_COUNT >> 1)
+#define LAT_BUCKETS				(LAT_SUB_COUNT + (64 - LAT_SUB_BITS) * LAT_HALF_COUNT)
+
+static const char* lat_names[LAT_NUM_TYPES] = { "get", "insert_ok",
+		"insert_fail", "delete_ok", "delete_fail", "fix_to_key" };
+
+typedef struct lat_hist {
+	unsigned long count;
+	unsigned long min;
+	unsigned long max;
+	unsigned long buckets[LAT_BUCKETS];
+} lat_hist_t;
+
+typedef struct latency {
+	unsigned long period; // record one operation out of every period
+	unsigned long tick;
+	unsigned long start;  // 0 when the current operation is not sampled
+	lat_hist_t hist[LAT_NUM_TYPES];
+} latency_t;
+
+static inline unsigned long read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long) hi << 32) | lo;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+static inline int lat_index(const unsigned long v) {
+	if (v < LAT_SUB_COUNT)
+		return v;
+	const int msb = 63 - __builtin_clzl(v);
+	const int e = msb - LAT_SUB_BITS + 1;
+	return LAT_SUB_COUNT + (e - 1) * LAT_HALF_COUNT
+			+ ((v >> e) - LAT_HALF_COUNT);
+}
+
+// highest value that maps to bucket i
+static inline unsigned long lat_value_at(const int i) {
+	if (i < LAT_SUB_COUNT)
+		return i;
+	const int e = (i - LAT_SUB_COUNT) / LAT_HALF_COUNT + 1;
+	const unsigned long top = (i - LAT_SUB_COUNT) % LAT_HALF_COUNT
+			+ LAT_HALF_COUNT;
+	return ((top + 1) << e) - 1;
+}
+
+static inline void lat_init(latency_t* l, const unsigned long period) {
+	memset(l, 0, sizeof(latency_t));
+	l->period = period;
+	for (int i = 0; i < LAT_NUM_TYPES; ++i)
+		l->hist[i].min = ~0UL;
+}
+
+static inline void lat_record(lat_hist_t* h, const unsigned long ticks) {
+	h->buckets[lat_index(ticks)]++;
+	h->count++;
+	if (ticks < h->min)
+		h->min = ticks;
+	if (ticks > h->max)
+		h->max = ticks;
+}
+
+static inline void lat_start(latency_t* l) {
+	if (!l)
+		return;
+	if (++l->tick >= l->period) {
+		l->tick = 0;
+		l->start = read_tsc();
+	} else {
+		l->start = 0;
+	}
+}
+
+// as lat_start, but a sampled operation is timed from start (if not 0),
+// its intended issue time in an open-loop run
+static inline void lat_start_at(latency_t* l, const unsigned long start) {
+	if (!l)
+		return;
+	if (++l->tick >= l->period) {
+		l->tick = 0;
+		l->start = start ? start : read_tsc();
+	} else {
+		l->start = 0;
+	}
+}
+
+static inline void lat_stop(latency_t* l, const int type) {
+	if (l && l->start)
+		lat_record(&l->hist[type], read_tsc() - l->start);
+}
+
+// fix_to_key times itself only in builds with -DFIX_TIMING (make
+// FIX_TIMING=1), so that runs without the fix_to_key histogram do not pay
+// two rdtsc per call; otherwise the ticks stay 0
+#ifdef FIX_TIMING
+#define FIX_TIMER_START(start)			const unsigned long start = read_tsc()
+#define FIX_TIMER_STOP(start, ticks)	((ticks) += read_tsc() - (start))
+#else
+#define FIX_TIMER_START(start)			do {} while (0)
+#define FIX_TIMER_STOP(start, ticks)	do {} while (0)
+#endif
+
+// fix_to_key time is measured inside the tree and handed over through *ticks
+// (null for sets without fix_to_key)
+static inline void lat_fix(latency_t* l, unsigned long* ticks) {
+	if (!ticks || !*ticks)
+		return;
+	if (l && l->start)
+		lat_record(&l->hist[LAT_FIX], *ticks);
+	*ticks = 0;
+}
+
+static inline void lat_merge(latency_t* dst, const latency_t* src) {
+	for (int t = 0; t < LAT_NUM_TYPES; ++t) {
+		lat_hist_t* a = &dst->hist[t];
+		const lat_hist_t* b = &src->hist[t];
+		for (int i = 0; i < LAT_BUCKETS; ++i)
+			a->buckets[i] += b->buckets[i];
+		a->count += b->count;
+		if (b->min < a->min)
+			a->min = b->min;
+		if (b->max > a->max)
+			a->max = b->max;
+	}
+}
+
+static inline unsigned long lat_percentile(const lat_hist_t* h, const double p) {
+	if (!h->count)
+		return 0;
+	unsigned long rank = (unsigned long) (p / 100 * h->count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	unsigned long seen = 0;
+	for (int i = 0; i < LAT_BUCKETS; ++i) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			return lat_value_at(i) < h->max ? lat_value_at(i) : h->max;
+	}
+	return h->max;
+}
+
+// TSC ticks per nanosecond, measured against CLOCK_MONOTONIC
+static inline double lat_calibrate() {
+	struct timespec t0, t1, pause = { 0, 50000000 };
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	const unsigned long c0 = read_tsc();
+	nanosleep(&pause, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	const unsigned long c1 = read_tsc();
+	const double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	return (c1 - c0) / ns;
+}
+
+// one "(p50 p99 p99.9)" field per operation type, in nanoseconds
+static inline void lat_print_csv(FILE* f, const latency_t* l,
+		const double ticks_per_ns) {
+	for (int t = 0; t < LAT_NUM_TYPES; ++t) {
+		const lat_hist_t* h = &l->hist[t];
+		fprintf(f, ",(%.0f %.0f %.0f)", lat_percentile(h, 50) / ticks_per_ns,
+				lat_percentile(h, 99) / ticks_per_ns,
+				lat_percentile(h, 99.9) / ticks_per_ns);
+	}
+}
+
+static inline void lat_print_json(FILE* f, const latency_t* l,
+		const double ticks_per_ns) {
+	static const double ps[] = { 50, 90, 99, 99.9, 99.99 };
+	fprintf(f, "{\"unit\":\"ns\",\"sample_period\":%lu", l->period);
+	for (int t = 0; t < LAT_NUM_TYPES; ++t) {
+		const lat_hist_t* h = &l->hist[t];
+		fprintf(f, ",\"%s\":{\"count\":%lu,\"min\":%.0f,\"max\":%.0f",
+				lat_names[t], h->count,
+				h->count ? h->min / ticks_per_ns : 0, h->max / ticks_per_ns);
+		for (int i = 0; i < sizeof(ps) / sizeof(ps[0]); ++i)
+			fprintf(f, ",\"p%g\":%.0f", ps[i],
+					lat_percentile(h, ps[i]) / ticks_per_ns);
+		fprintf(f, "}");
+	}
+	fprintf(f, "}\n");
+}
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,98 @@
+/*
+ * mem_stats.h
+ *
+ *  Memory footprint of a set. Nothing is ever freed, so every node and
+ *  SCX descriptor that is no longer reachable is leaked. The per-thread
+ *  allocation counters are compiled in only with -DMEM_STATS
+ *  (make MEM_STATS=1); the live footprint is measured by walking the set
+ *  after the run and is always available.
+ */
+
+#ifndef MEM_STATS_H_
+#define MEM_STATS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct mem_stats {
+	unsigned long nodes;        // nodes allocated
+	unsigned long ops;          // SCX descriptors allocated
+	unsigned long retired;      // nodes unlinked by a committed SCX
+} mem_stats_t;
+
+#ifdef MEM_STATS
+extern __thread mem_stats_t mem_stats;
+#define MEM_ADD(field, n)		(mem_stats.field += (n))
+#else
+#define MEM_ADD(field, n)		do {} while (0)
+#endif
+#define MEM_INC(field)			MEM_ADD(field, 1)
+
+// what is reachable from the root when the set is quiescent
+typedef struct mem_footprint {
+	unsigned long nodes;
+	unsigned long ops;          // distinct descriptors the live nodes point to
+	unsigned long bytes;
+	unsigned long aux_bytes;    // filters and caches kept beside the nodes
+	size_t node_size;           // 0 if nodes have no fixed size
+	size_t op_size;
+} mem_footprint_t;
+
+static inline void mem_stats_merge(mem_stats_t* dst, const mem_stats_t* src) {
+	dst->nodes += src->nodes;
+	dst->ops += src->ops;
+	dst->retired += src->retired;
+}
+
+// dst -= src, for the counters of the main thread across one run
+static inline void mem_stats_sub(mem_stats_t* dst, const mem_stats_t* src) {
+	dst->nodes -= src->nodes;
+	dst->ops -= src->ops;
+	dst->retired -= src->retired;
+}
+
+static int mem_ptr_cmp(const void* a, const void* b) {
+	const unsigned long x = *(const unsigned long*) a;
+	const unsigned long y = *(const unsigned long*) b;
+	return x < y ? -1 : x > y;
+}
+
+// number of distinct pointers in ptrs, which is sorted in place
+static inline unsigned long mem_distinct(unsigned long* ptrs,
+		const unsigned long n) {
+	if (!n)
+		return 0;
+	qsort(ptrs, n, sizeof(unsigned long), mem_ptr_cmp);
+	unsigned long distinct = 1;
+	for (unsigned long i = 1; i < n; ++i)
+		if (ptrs[i] != ptrs[i - 1])
+			distinct++;
+	return distinct;
+}
+
+// mem,<live footprint>,<aux>,rss_kb=[,<allocation counters, if s is not null>]
+static inline void mem_print(FILE* f, const mem_footprint_t* m,
+		const mem_stats_t* s, const unsigned long keys,
+		const unsigned long rss_kb) {
+	const double n = keys ? (double) keys : 1;
+	const unsigned long live = m->bytes;
+	fprintf(f, "mem,node_size=%zu,op_size=%zu,live_nodes=%lu,live_ops=%lu,"
+			"live_bytes=%lu,live_bytes_per_key=%.1f,aux_bytes=%lu,"
+			"aux_bytes_per_key=%.1f,rss_kb=%lu,rss_bytes_per_key=%.1f",
+			m->node_size, m->op_size, m->nodes, m->ops, live, live / n,
+			m->aux_bytes, m->aux_bytes / n, rss_kb, rss_kb * 1024.0 / n);
+	if (s) {
+		const unsigned long allocated = s->nodes * m->node_size
+				+ s->ops * m->op_size;
+		// allocated, never linked in: lost create_* attempts and aborted SCXs
+		const unsigned long unpublished = s->nodes > m->nodes + s->retired ?
+				s->nodes - m->nodes - s->retired : 0;
+		fprintf(f, ",alloc_nodes=%lu,alloc_ops=%lu,alloc_bytes=%lu,"
+				"alloc_bytes_per_key=%.1f,retired_nodes=%lu,unpublished_nodes=%lu,"
+				"leaked_bytes=%lu", s->nodes, s->ops, allocated, allocated / n,
+				s->retired, unpublished, allocated > live ? allocated - live : 0);
+	}
+	fprintf(f, "\n");
+}
+
+#endif /* MEM_STATS_H_ */
@@ -0,0 +1,28 @@
+/*
+ * modes.h
+ *
+ *  Optional behaviours of a set. The driver switches them on through
+ *  engine_t.set_modes before init; engine_t.modes lists the ones an
+ *  engine implements.
+ */
+
+#ifndef MODES_H_
+#define MODES_H_
+
+#define MODE_FINGER				(1 << 0) // searches start from the thread's last path
+#define MODE_APPEND				(1 << 1) // inserts past the maximum go straight to the spine
+#define MODE_ELIM				(1 << 2) // insert/delete pairs on a key cancel out (elim.h)
+#define MODE_COMBINE			(1 << 3) // contended threads hand updates to a combiner (fc.h)
+#define MODE_BACKOFF			(1 << 4) // updates back off after a failed attempt (backoff.h)
+#define MODE_LAZY_HELP			(1 << 5) // weak_llx waits for the owner of an SCX before helping it
+#define MODE_CACHE				(1 << 6) // get consults a cache of recent search results (cache.h)
+#define MODE_BLOOM				(1 << 7) // get consults a counting Bloom filter first (bloom.h)
+#define MODE_RANK				(1 << 8) // subtree key counts are kept up to date (rank.h)
+#define MODE_SIZE				(1 << 9) // size() is linearizable, holding off updates (counter.h)
+#define MODE_SNAPSHOT			(1 << 10) // updates keep the nodes they replace for scans (snapshot.h)
+
+// in MODE_APPEND, appends of all threads before one repairs the right
+// spine, when d allows that many violations on a path
+#define APPEND_FIX_BATCH		16
+
+#endif /* MODES_H_ */
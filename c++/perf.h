@@ -0,0 +1,220 @@
+/*
+ * perf.h
+ *
+ *  Per-thread event counters around the timed region. Hardware counters
+ *  come from perf_event_open (cycles, instructions, L1D/LLC/dTLB read
+ *  misses, branch misses). When the PMU is not available (virtual
+ *  machines, perf_event_paranoid, seccomp) the kernel's software events
+ *  are used instead, and failing those getrusage and the thread CPU
+ *  clock. perf_probe() picks the level once, before the threads start.
+ */
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef RUSAGE_THREAD
+#define RUSAGE_THREAD			1 // Linux, only declared with _GNU_SOURCE
+#endif
+
+#define PERF_MAX_EVENTS			6
+
+#define PERF_OFF				0
+#define PERF_HW					1 // perf_event_open hardware events
+#define PERF_SW					2 // perf_event_open software events
+#define PERF_RUSAGE				3 // getrusage and CLOCK_THREAD_CPUTIME_ID
+
+typedef struct perf_event_def {
+	const char* name;
+	uint32_t type;
+	uint64_t config;
+} perf_event_def_t;
+
+#define PERF_CACHE_MISS(cache)	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+		| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const perf_event_def_t perf_hw_events[PERF_MAX_EVENTS] = {
+		{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ "l1d_miss", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+		{ "llc_miss", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+		{ "dtlb_miss", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+		{ "branch_miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES } };
+
+static const perf_event_def_t perf_sw_events[PERF_MAX_EVENTS] = {
+		{ "task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+		{ "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+		{ "ctx_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+		{ "cpu_migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+		{ NULL, 0, 0 }, { NULL, 0, 0 } };
+
+static const char* perf_rusage_names[PERF_MAX_EVENTS] = { "cpu_ns",
+		"minor_faults", "major_faults", "voluntary_cs", "involuntary_cs", NULL };
+
+typedef struct perf_counters {
+	int mode;
+	int fd[PERF_MAX_EVENTS];
+	bool valid[PERF_MAX_EVENTS];
+	unsigned long value[PERF_MAX_EVENTS];
+	unsigned long base[PERF_MAX_EVENTS]; // PERF_RUSAGE readings at the start
+} perf_counters_t;
+
+static inline const char* perf_mode_name(const int mode) {
+	switch (mode) {
+	case PERF_HW:
+		return "hw";
+	case PERF_SW:
+		return "sw";
+	case PERF_RUSAGE:
+		return "rusage";
+	default:
+		return "off";
+	}
+}
+
+static inline const char* perf_event_name(const int mode, const int i) {
+	if (mode == PERF_HW)
+		return perf_hw_events[i].name;
+	if (mode == PERF_SW)
+		return perf_sw_events[i].name;
+	return perf_rusage_names[i];
+}
+
+// counts the calling thread in user space; -1 if the event cannot be opened
+static inline int perf_open_event(const perf_event_def_t* e) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = e->type;
+	attr.config = e->config;
+	attr.disabled = 1;
+	attr.exclude_kernel = e->type != PERF_TYPE_SOFTWARE;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+			| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// the best level available to this process
+static inline int perf_probe() {
+	const perf_event_def_t* levels[2] = { perf_hw_events, perf_sw_events };
+	for (int l = 0; l < 2; ++l) {
+		const int fd = perf_open_event(&levels[l][0]);
+		if (fd >= 0) {
+			close(fd);
+			return l == 0 ? PERF_HW : PERF_SW;
+		}
+	}
+	return PERF_RUSAGE;
+}
+
+static inline void perf_rusage_read(unsigned long* v) {
+	struct rusage ru;
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	getrusage(RUSAGE_THREAD, &ru);
+	v[0] = ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	v[1] = ru.ru_minflt;
+	v[2] = ru.ru_majflt;
+	v[3] = ru.ru_nvcsw;
+	v[4] = ru.ru_nivcsw;
+	v[5] = 0;
+}
+
+// opens the counters of the calling thread at the given level; events the
+// PMU does not have are left out of the report
+static inline void perf_open(perf_counters_t* p, const int mode) {
+	memset(p, 0, sizeof(perf_counters_t));
+	p->mode = mode;
+	for (int i = 0; i < PERF_MAX_EVENTS; ++i) {
+		p->fd[i] = -1;
+		if (mode == PERF_RUSAGE) {
+			p->valid[i] = perf_rusage_names[i] != NULL;
+			continue;
+		}
+		const perf_event_def_t* e = mode == PERF_HW ?
+				&perf_hw_events[i] : &perf_sw_events[i];
+		if (e->name)
+			p->fd[i] = perf_open_event(e);
+		p->valid[i] = p->fd[i] >= 0;
+	}
+}
+
+static inline void perf_start(perf_counters_t* p) {
+	if (!p)
+		return;
+	if (p->mode == PERF_RUSAGE) {
+		perf_rusage_read(p->base);
+		return;
+	}
+	for (int i = 0; i < PERF_MAX_EVENTS; ++i) {
+		if (p->fd[i] < 0)
+			continue;
+		ioctl(p->fd[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(p->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+// stops and reads the counters, scaling multiplexed events to the time
+// they were enabled, then closes them
+static inline void perf_stop(perf_counters_t* p) {
+	if (!p)
+		return;
+	if (p->mode == PERF_RUSAGE) {
+		unsigned long now[PERF_MAX_EVENTS];
+		perf_rusage_read(now);
+		for (int i = 0; i < PERF_MAX_EVENTS; ++i)
+			p->value[i] = now[i] - p->base[i];
+		return;
+	}
+	for (int i = 0; i < PERF_MAX_EVENTS; ++i) {
+		if (p->fd[i] < 0)
+			continue;
+		ioctl(p->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		uint64_t r[3]; // value, time enabled, time running
+		if (read(p->fd[i], r, sizeof(r)) != sizeof(r) || !r[2]) {
+			p->valid[i] = false;
+		} else {
+			p->value[i] = r[2] < r[1] ?
+					(unsigned long) ((double) r[0] * r[1] / r[2]) : r[0];
+		}
+		close(p->fd[i]);
+		p->fd[i] = -1;
+	}
+}
+
+// an event is reported only if every thread counted it
+static inline void perf_merge(perf_counters_t* dst, const perf_counters_t* src) {
+	for (int i = 0; i < PERF_MAX_EVENTS; ++i) {
+		dst->value[i] += src->value[i];
+		dst->valid[i] &= src->valid[i];
+	}
+}
+
+// ",perf=<mode>,(name=value ...)" with the values per operation
+static inline void perf_print_csv(FILE* f, const perf_counters_t* p,
+		const unsigned long ops) {
+	fprintf(f, ",perf=%s,(", perf_mode_name(p->mode));
+	bool first = true;
+	for (int i = 0; i < PERF_MAX_EVENTS; ++i) {
+		if (!p->valid[i])
+			continue;
+		fprintf(f, first ? "%s=%.3f" : " %s=%.3f", perf_event_name(p->mode, i),
+				ops ? (double) p->value[i] / ops : 0);
+		first = false;
+	}
+	if (p->mode == PERF_HW && p->valid[0] && p->valid[1] && p->value[0])
+		fprintf(f, " ipc=%.3f", (double) p->value[1] / p->value[0]);
+	fprintf(f, ")");
+}
+
+#endif /* PERF_H_ */
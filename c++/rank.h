@@ -0,0 +1,35 @@
+/*
+ * rank.h
+ *
+ *  Order statistics over the trees (MODE_RANK). Every node carries the
+ *  number of keys below it, which init_node computes from the children
+ *  when an SCX builds the node. The ancestors of a change are not copied,
+ *  so after each committed SCX the thread refreshes the counts of the new
+ *  nodes and then of the search path of the key, bottom-up. A refresh
+ *  CASes the count from the sum of the children; the word carries a
+ *  version so the CAS cannot succeed on a recycled value, and a failed
+ *  refresh is retried once, after which some refresh that read the
+ *  children later has won. A path that lost a node to a concurrent SCX
+ *  is walked again. Once the updates are over every count is exact, so
+ *  rank and select are exact when quiescent and approximate otherwise.
+ */
+
+#ifndef RANK_H_
+#define RANK_H_
+
+#define COUNT_WORD(version, keys)	(((version) << 32) | (keys))
+#define COUNT_VERSION(w)		((w) >> 32)
+#define COUNT_KEYS(w)			((w) & 0xffffffffUL)
+
+// subtrees of the new node set an SCX installs that may need a refresh
+#define COUNT_SUBTREE_DEPTH		2
+
+// the counts are compiled in only with make RANK_COUNTS=1, so that without
+// it nodes are no bigger than before; engines offer MODE_RANK only then
+#ifdef RANK_COUNTS
+#define RANK_MODES				MODE_RANK
+#else
+#define RANK_MODES				0
+#endif
+
+#endif /* RANK_H_ */
@@ -9,10 +9,42 @@
 #include <assert.h>
 #include "dwrbavl.h"
 #include "atomic_ops.h"
+#include "../latency.h"
+#include "../elim.h"
+#include "../fc.h"
+#include "../backoff.h"
+#include "../cache.h"
+#include "../bloom.h"
+#include "../counter.h"
+#include "../snapshot.h"
+
+const char* rebalance_names[] = { "promote", "rotate1", "rotate2",
+		"double_rotate", null };
+
+const char* stats_gap_name = "rank_gap";
 
 volatile operation_t* dummy = null;
 node_t* root = null;
 int d = 0; // number of violations
+int modes = 0; // MODE_* flags
+__thread finger_t finger; // this thread's last search path
+volatile node_t* right_hint = null; // parent of the rightmost leaf, see append_search
+volatile unsigned long spine_appends = 0; // appends of all threads, see insert_key
+elim_array_t elim; // insert/delete pairs, see eliminate
+fc_array_t fc; // combined updates of contended threads, see fc.h
+cache_t cache; // leaves recent gets ended at, see cache.h
+bloom_t bloom; // keys that may be in the set, see bloom.h
+unsigned long expected_keys = 0; // see reserve
+unsigned long expected_range = 0;
+counter_t key_count; // keys in the set, see tree_size
+volatile unsigned long snapshot_version = 1; // tag of new updates, see snapshot.h
+__thread unsigned long fix_ticks = 0; // ticks spent in fix_to_key by this thread
+#ifdef SCX_STATS
+__thread scx_stats_t scx_stats;
+#endif
+#ifdef MEM_STATS
+__thread mem_stats_t mem_stats;
+#endif
 
 int init_node(node_t* node_ptr, const unsigned long key, const unsigned long rank,
 		volatile node_t* left, volatile node_t* right,
@@ -24,6 +56,14 @@ int init_node(node_t* node_ptr, const unsigned long key, const unsigned long ran
 	node_ptr->right = right;
 	node_ptr->marked = false;
 	node_ptr->op = op;
+#ifdef RANK_COUNTS
+	node_ptr->count = left ? keys_below(left) + keys_below(right)
+			: key != ULONG_MAX;
+#endif
+#ifdef SNAPSHOT_VERSIONS
+	node_ptr->version = 0; // in every snapshot with its parent
+	node_ptr->replaced = null;
+#endif
 	return SUCCESS;
 }
 
@@ -46,28 +86,62 @@ int init_op(operation_t* op_ptr) {
 	return SUCCESS;
 }
 
+void init_range_op(range_operation_t* op_ptr) {
+	init_op(&op_ptr->op);
+}
+
+// a range op is built in its own arrays, but help_scx reads nodes[0] and
+// nodes[1] from op, and all of them if they fit there
+static volatile operation_t* range_op_done(range_operation_t* op_ptr) {
+	const int n = op_ptr->op.ops_size > MAX_OPS_SIZE ? 2 : op_ptr->op.ops_size;
+	for (int i = 0; i < n; ++i) {
+		op_ptr->op.nodes[i] = op_ptr->nodes[i];
+		op_ptr->op.ops[i] = op_ptr->ops[i];
+	}
+	return &op_ptr->op;
+}
+
 void clear_op(volatile operation_t* op_ptr) {
 	op_ptr->subtree = 0;
 	op_ptr->ops_size = 0;
 }
 
 int init_tree(const int all_violation_per_path) {
-	dummy = (operation_t*) xmalloc(sizeof(operation_t));
+	dummy = alloc_op();
 	init_dummy_op(dummy);
 
-	node_t* sentinel = (node_t*) xmalloc(sizeof(node_t));
+	node_t* sentinel = alloc_node();
 	init_node(sentinel, ULONG_MAX, ULONG_MAX, null, null, dummy);
 
-	root = (node_t*) xmalloc(sizeof(node_t));
+	root = alloc_node();
 	init_node(root, ULONG_MAX, ULONG_MAX, sentinel, null, dummy);
 
 	d = all_violation_per_path;
+	finger.depth = 0; // the calling thread's path is in the old tree
+	right_hint = null;
+	fc_reset(&fc, expected_range);
+	cache_clear(&cache);
+	if (modes & MODE_BLOOM)
+		bloom_init(&bloom, expected_keys);
+	counter_reset(&key_count);
 
 	return SUCCESS;
 }
 
+void set_modes(const int m) {
+	modes = m;
+}
+
+void reserve(const unsigned long keys, const unsigned long range) {
+	expected_keys = keys;
+	expected_range = range;
+}
+
+// from the per-thread counts of successful updates; without MODE_SIZE it
+// misses the updates in progress
 int tree_size() {
-	return sequential_size(root);
+	return modes & MODE_SIZE ? counter_exact(&key_count)
+			: counter_sum(&key_count);
 }
 
 int sequential_size(volatile node_t* node) {
@@ -78,47 +152,167 @@ int sequential_size(volatile node_t* node) {
 	return sequential_size(node->left) + sequential_size(node->right);
 }
 
+// whether leaf l, found as a child of p, is still in the tree; every SCX
+// that unlinks a leaf freezes and marks it
+bool leaf_in_tree(volatile node_t* p, volatile node_t* l) {
+	return !l->marked;
+}
+
+static bool cached_leaf_live(volatile void* p, volatile void* l) {
+	return leaf_in_tree((volatile node_t*) p, (volatile node_t*) l);
+}
+
 bool get(const unsigned long key) {
-	volatile node_t* l = root->left->left;
-	if (!l) {
-		return false; // the key is not in the dictionary
+	volatile node_t* p;
+	volatile node_t* l;
+	if ((modes & MODE_BLOOM) && !bloom_contains(&bloom, key)) {
+		STAT_INC(bloom_negatives);
+		return false;
 	}
-	while (l->left) {
-		l = key < l->key ? l->left : l->right;
+	if (modes & MODE_CACHE) {
+		l = cache_lookup(&cache, key, (volatile void**) &p);
+		if (l && leaf_in_tree(p, l)) {
+			STAT_INC(cache_hits);
+			return l->key == key;
+		}
+		STAT_INC(cache_misses);
 	}
-	if (l->key == key) {
-		return true;
+	if (modes & MODE_FINGER) {
+		finger_search(key, null, &p, &l);
 	} else {
-		return false;
+		p = root->left;
+		l = p->left;
+		if (!l) {
+			return false; // the key is not in the dictionary
+		}
+		while (l->left) {
+			p = l;
+			l = key < l->key ? l->left : l->right;
+		}
 	}
+	if (modes & MODE_CACHE)
+		cache_fill(&cache, key, p, l, cached_leaf_live);
+	if ((modes & MODE_BLOOM) && l->key != key)
+		STAT_INC(bloom_false_positives);
+	return l->key == key;
 }
 
 bool insert(const unsigned long key) {
+	if ((modes & MODE_COMBINE) && fc_contended())
+		return fc_apply(&fc, key, FC_INSERT, insert, delete);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		snapshot_enter(&key_count, &snapshot_version);
+	if (modes & MODE_BLOOM)
+		bloom_add(&bloom, key); // before the key can be found, see bloom.h
+	const bool added = insert_key(key);
+	if (added)
+		counter_add(&key_count, 1);
+	else if (modes & MODE_BLOOM)
+		bloom_remove(&bloom, key);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		counter_leave(&key_count);
+	return added;
+}
+
+bool delete(const unsigned long key) {
+	if ((modes & MODE_COMBINE) && fc_contended())
+		return fc_apply(&fc, key, FC_DELETE, insert, delete);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		snapshot_enter(&key_count, &snapshot_version);
+	const bool removed = delete_key(key);
+	if (removed) {
+		counter_add(&key_count, -1);
+		if (modes & MODE_BLOOM)
+			bloom_remove(&bloom, key);
+	}
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		counter_leave(&key_count);
+	return removed;
+}
+
+// delete_range_keys with the bookkeeping of delete
+unsigned long delete_range(const unsigned long lo, const unsigned long hi) {
+	if (lo > hi)
+		return 0;
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		snapshot_enter(&key_count, &snapshot_version);
+	const unsigned long removed = delete_range_keys(lo,
+			hi < ULONG_MAX ? hi : ULONG_MAX - 1);
+	counter_add(&key_count, -(long) removed);
+	if (modes & (MODE_SIZE | MODE_SNAPSHOT))
+		counter_leave(&key_count);
+	return removed;
+}
+
+bool insert_key(const unsigned long key) {
 	volatile operation_t* op = 0;
 	volatile node_t* p = 0;
 	volatile node_t* l = 0;
 	int count = 0;
+	bool append = false;
+	int attempts = 0; // searches; elimination is offered on the first retry
+	if ((modes & MODE_ELIM) && elim_take(&elim, key, ELIM_INSERT)) {
+		STAT_INC(elim_hits);
+		return true;
+	}
 	while (true) {
 		while (!op) {
-			p = root;
-			l = root->left;
-			if (l->left) {
-				p = l;
-				l = l->left;
-				while (l->left) {
-					if (d > 0 && (l->rank == p->rank))
-						++count;
+			++attempts;
+			append = (modes & MODE_APPEND) && append_search(key, &p, &l);
+			if (append) {
+				// p and l are the rightmost leaf and its parent
+			} else if (modes & MODE_FINGER) {
+				count = finger_search(key, null, &p, &l);
+			} else {
+				p = root;
+				l = root->left;
+				if (l->left) {
 					p = l;
-					l = key < l->key ? l->left : l->right;
+					l = l->left;
+					while (l->left) {
+						if (d > 0 && (l->rank == p->rank))
+							++count;
+						p = l;
+						l = key < l->key ? l->left : l->right;
+					}
 				}
 			}
 			if (l->key == key) {
 				return false;
 			} else {
+				if ((modes & MODE_ELIM) && attempts == 2) {
+					if (eliminate(key, ELIM_INSERT, l))
+						return true;
+				}
 				op = create_insert_operation(p, l, key);
+				if (!op) {
+					STAT_INC(create_null);
+					fc_conflict();
+					if (modes & MODE_BACKOFF)
+						backoff_abort();
+					finger.depth = 0; // the path may be stale
+				}
 			}
 		}
 		if (help_scx(op, 0)) {
+			if (modes & MODE_BACKOFF)
+				backoff_commit();
+			if (modes & MODE_RANK)
+				count_update(key, op->subtree);
+			if (append) {
+				right_hint = op->subtree;
+				if (d > 0) {
+					// the violations of up to d - 1 appends wait on the right
+					// spine; the append that completes a batch, whichever
+					// thread made it, repairs the whole spine
+					const unsigned long batch = d < APPEND_FIX_BATCH ? d
+							: APPEND_FIX_BATCH;
+					if ((AO_fetch_and_add_full((AO_t*) &spine_appends, 1) + 1)
+							% batch == 0)
+						fix_to_key(ULONG_MAX - 1);
+					return true;
+				}
+			}
 			if (d == 0) {
 				if (l->rank == 0)
 					fix_to_key(key);
@@ -129,55 +323,409 @@ bool insert(const unsigned long key) {
 
 			return true;
 		}
+		fc_conflict(); // the SCX lost to a concurrent one
+		if (modes & MODE_BACKOFF)
+			backoff_abort();
 		op = 0;
 	}
 }
 
-bool delete(const unsigned long key) {
+bool delete_key(const unsigned long key) {
 	volatile node_t* gp = 0;
 	volatile node_t* p = 0;
 	volatile node_t* l = 0;
 	volatile operation_t* op = 0;
+	int attempts = 0; // searches; elimination is offered on the first retry
+	if ((modes & MODE_ELIM) && elim_take(&elim, key, ELIM_DELETE)) {
+		STAT_INC(elim_hits);
+		return true;
+	}
 	while (true) {
 		while (!op) {
-			gp = root;
-			p = root;
-			l = root->left;
-			if (l->left) {
-				gp = p;
-				p = l;
-				l = l->left;
-				while (l->left) {
+			++attempts;
+			if (modes & MODE_FINGER) {
+				finger_search(key, &gp, &p, &l);
+			} else {
+				gp = root;
+				p = root;
+				l = root->left;
+				if (l->left) {
 					gp = p;
 					p = l;
-					l = key < l->key ? l->left : l->right;
+					l = l->left;
+					while (l->left) {
+						gp = p;
+						p = l;
+						l = key < l->key ? l->left : l->right;
+					}
 				}
 			}
 
 			if (l->key != key) {
 				return false; // the key is not in the dictionary
 			} else {
+				if ((modes & MODE_ELIM) && attempts == 2) {
+					if (eliminate(key, ELIM_DELETE, l))
+						return true;
+				}
 				op = create_remove_operation(gp, p, l);
+				if (!op) {
+					STAT_INC(create_null);
+					fc_conflict();
+					if (modes & MODE_BACKOFF)
+						backoff_abort();
+					finger.depth = 0; // the path may be stale
+				}
 			}
 		}
 		if (help_scx(op, 0)) {
+			if (modes & MODE_BACKOFF)
+				backoff_commit();
+			if (modes & MODE_RANK)
+				count_update(key, op->subtree);
 			return true;
 		}
+		fc_conflict(); // the SCX lost to a concurrent one
+		if (modes & MODE_BACKOFF)
+			backoff_abort();
 		op = 0;
 	}
 }
 
+/*
+ * The first subtree below n, in key order, whose routing keys put all of
+ * its keys in [lo, hi], or failing that the first leaf in [lo, hi]; null
+ * if there is none. n is a child of p and p of gp, and [klo, khi) are the
+ * keys the nodes above n route to it. Only the search paths of lo and hi
+ * are walked: every other node in the range lies below one the walk
+ * returns.
+ */
+static volatile node_t* range_find(volatile node_t* gp, volatile node_t* p,
+		volatile node_t* n, const unsigned long klo, const unsigned long khi,
+		const unsigned long lo, const unsigned long hi,
+		volatile node_t** gp_ptr, volatile node_t** p_ptr) {
+	if (!n)
+		return null;
+	if ((klo >= lo && khi - 1 <= hi)
+			|| (!n->left && n->key >= lo && n->key <= hi)) {
+		*gp_ptr = gp;
+		*p_ptr = p;
+		return n;
+	}
+	if (!n->left)
+		return null;
+	if (n->key >= lo && khi - 1 <= hi) {
+		// the right child is in the range, while the left one is not known
+		// to be: once the keys left of the range are gone, the nodes on the
+		// path of lo still route keys below lo to their left children
+		*gp_ptr = p;
+		*p_ptr = n;
+		return n->right;
+	}
+	volatile node_t* x = null;
+	if (lo < n->key)
+		x = range_find(p, n, n->left, klo, n->key, lo, hi, gp_ptr, p_ptr);
+	if (!x && hi >= n->key)
+		x = range_find(p, n, n->right, n->key, khi, lo, hi, gp_ptr, p_ptr);
+	return x;
+}
+
+// the nodes below n that range_collect freezes, counted up to limit + 1
+static int range_size(volatile node_t* n, const int limit) {
+	if (!n->left)
+		return 1;
+	if (limit < 3)
+		return limit + 1;
+	const int left = range_size(n->left, limit - 2);
+	if (left > limit - 2)
+		return limit + 1;
+	return 1 + left + range_size(n->right, limit - 1 - left);
+}
+
+// x, or else the highest node on its left path small enough for one
+// range removal; *gp_ptr and *p_ptr follow it down
+static volatile node_t* range_fit(volatile node_t* x, volatile node_t** gp_ptr,
+		volatile node_t** p_ptr) {
+	while (x->left && range_size(x, RANGE_SUBTREE_MAX) > RANGE_SUBTREE_MAX) {
+		*gp_ptr = *p_ptr;
+		*p_ptr = x;
+		x = x->left;
+	}
+	return x;
+}
+
+// the keys below n, which a committed range removal froze and unlinked
+static unsigned long range_detached(volatile node_t* n) {
+	if (n->left)
+		return range_detached(n->left) + range_detached(n->right);
+	if (modes & MODE_BLOOM)
+		bloom_remove(&bloom, n->key); // after the key left, see bloom.h
+	return 1;
+}
+
+/*
+ * Removes the keys in [lo, hi] and returns their number. Each SCX
+ * detaches a whole subtree of at most RANGE_SUBTREE_MAX nodes in the
+ * range, replacing its parent by its sibling like delete_key does for a
+ * leaf; only the nodes on the paths of lo and hi are left to remove one
+ * leaf at a time. Like every removal here it does not rebalance. Keys
+ * inserted into the range meanwhile may stay.
+ */
+unsigned long delete_range_keys(const unsigned long lo, const unsigned long hi) {
+	unsigned long removed = 0;
+	while (true) {
+		volatile node_t* gp;
+		volatile node_t* p;
+		volatile node_t* x = root->left->left ? range_find(root, root->left,
+				root->left->left, 0, ULONG_MAX, lo, hi, &gp, &p) : null;
+		if (!x)
+			return removed;
+		x = range_fit(x, &gp, &p);
+		bool too_big = false;
+		volatile operation_t* op = create_range_operation(gp, p, x, lo, hi,
+				&too_big);
+		while (!op && too_big) {
+			// x grew meanwhile; every node below it is in the range
+			gp = p;
+			p = x;
+			x = x->left;
+			too_big = false;
+			op = create_range_operation(gp, p, x, lo, hi, &too_big);
+		}
+		if (op && help_scx(op, 0)) {
+			if (modes & MODE_BACKOFF)
+				backoff_commit();
+			removed += range_detached(x);
+			if (modes & MODE_RANK)
+				count_update(x->key, op->subtree);
+			continue;
+		}
+		if (!op)
+			STAT_INC(create_null);
+		if (modes & MODE_BACKOFF)
+			backoff_abort();
+	}
+}
+
+// offers an update that found leaf l to a partner, see elim.h
+bool eliminate(const unsigned long key, const int type, volatile node_t* l) {
+	STAT_INC(elim_offers);
+	elim_slot_t* s = elim_offer(&elim, key, type);
+	if (!s)
+		return false;
+	const bool valid = !l->marked;
+	elim_answer(s, valid);
+	if (valid)
+		STAT_INC(elim_hits);
+	return valid;
+}
+
+// in append mode: the rightmost leaf and its parent, if key goes right of
+// the leaf. The hint left by the last append is used while its node is
+// not marked: such a node is still on the right spine, so a leaf right
+// child of it is the rightmost leaf. Otherwise walks down the spine.
+bool append_search(const unsigned long key, volatile node_t** p_ptr,
+		volatile node_t** l_ptr) {
+	volatile node_t* p = right_hint;
+	volatile node_t* l = p ? p->right : null;
+	if (!p || p->marked || !l || l->left) {
+		p = root->left;
+		l = p->left;
+		if (!l)
+			return false; // only sentinels in tree
+		while (l->left) {
+			p = l;
+			l = l->right;
+		}
+	}
+	if (is_sentinel(l) || key <= l->key)
+		return false;
+	*p_ptr = p;
+	*l_ptr = l;
+	return true;
+}
+
+// one attempt to set the count of internal node n from its children
+static bool count_refresh_once(volatile node_t* n) {
+#ifdef RANK_COUNTS
+	const unsigned long old = n->count;
+	const unsigned long keys = keys_below(n->left) + keys_below(n->right);
+	return AO_compare_and_swap((AO_t*) &n->count, (AO_t) old,
+			(AO_t) COUNT_WORD(COUNT_VERSION(old) + 1, keys));
+#else
+	return true;
+#endif
+}
+
+static void count_refresh(volatile node_t* n) {
+	if (!count_refresh_once(n))
+		count_refresh_once(n);
+}
+
+static void count_refresh_subtree(volatile node_t* n, const int depth) {
+	if (!n || !n->left)
+		return;
+	if (depth > 0) {
+		count_refresh_subtree(n->left, depth - 1);
+		count_refresh_subtree(n->right, depth - 1);
+	}
+	count_refresh(n);
+}
+
+// refreshes the search path of key below n, bottom-up; true if one of its
+// nodes was unlinked meanwhile
+static bool count_refresh_path(volatile node_t* n, const unsigned long key) {
+	if (!n->left)
+		return false;
+	const bool stale = count_refresh_path(key < n->key ? n->left : n->right,
+			key);
+	count_refresh(n);
+	return stale || n->marked;
+}
+
+// after a committed SCX that installed subtree on the search path of key,
+// see rank.h
+void count_update(const unsigned long key, volatile node_t* subtree) {
+	count_refresh_subtree(subtree, COUNT_SUBTREE_DEPTH);
+	while (count_refresh_path(root, key))
+		STAT_INC(count_restarts);
+}
+
+// the number of keys smaller than key
+unsigned long key_rank(const unsigned long key) {
+	unsigned long below = 0;
+	volatile node_t* n = root;
+	while (n->left) {
+		if (key < n->key) {
+			n = n->left;
+		} else {
+			below += keys_below(n->left);
+			n = n->right;
+			if (!n)
+				return below; // right of the root: key is ULONG_MAX
+		}
+	}
+	return below + (n->key < key);
+}
+
+// the key with i smaller ones, if there are more than i keys
+bool key_select(const unsigned long i, unsigned long* key) {
+	unsigned long rest = i;
+	volatile node_t* n = root;
+	while (n->left) {
+		const unsigned long left = keys_below(n->left);
+		if (rest < left) {
+			n = n->left;
+		} else {
+			rest -= left;
+			n = n->right;
+			if (!n)
+				return false;
+		}
+	}
+	if (rest || n->key == ULONG_MAX)
+		return false;
+	*key = n->key;
+	return true;
+}
+
+// visits the keys in [lo, hi] below n as of version v, in order
+static unsigned long scan_node(volatile node_t* n, const unsigned long v,
+		const unsigned long lo, const unsigned long hi,
+		void (*visit)(const unsigned long key, void* arg), void* arg) {
+	if (!n)
+		return 0;
+	if (!n->left) {
+		if (n->key < lo || n->key > hi || n->key == ULONG_MAX)
+			return 0;
+		visit(n->key, arg);
+		return 1;
+	}
+	unsigned long keys = 0;
+	if (lo < n->key)
+		keys += scan_node(snapshot_child(n->left, v), v, lo, hi, visit, arg);
+	if (hi >= n->key)
+		keys += scan_node(snapshot_child(n->right, v), v, lo, hi, visit, arg);
+	return keys;
+}
+
+// calls visit on the keys in [lo, hi] in order and returns their number;
+// in MODE_SNAPSHOT they are the keys of one instant, otherwise the scan
+// may see some concurrent updates and miss others
+unsigned long scan(const unsigned long lo, const unsigned long hi,
+		void (*visit)(const unsigned long key, void* arg), void* arg) {
+	const unsigned long v = modes & MODE_SNAPSHOT ?
+			snapshot_begin(&key_count, &snapshot_version) : ULONG_MAX;
+	return scan_node(root, v, lo, hi, visit, arg);
+}
+
+// the search of insert and delete, started from the deepest unmarked node
+// of the thread's last path that covers key; records the new path and
+// returns the violations counted along it (those above the starting node
+// as they were when it was recorded)
+int finger_search(const unsigned long key, volatile node_t** gp_ptr,
+		volatile node_t** p_ptr, volatile node_t** l_ptr) {
+	volatile node_t* gp = root;
+	volatile node_t* p = root;
+	volatile node_t* l = root->left;
+	unsigned long lo = 0;
+	unsigned long hi = ULONG_MAX;
+	int count = 0;
+	const int i = finger_find(&finger, key);
+	if (i >= 1 && !((volatile node_t*) finger.path[i].node)->marked) {
+		gp = i >= 2 ? (volatile node_t*) finger.path[i - 2].node : root->left;
+		p = (volatile node_t*) finger.path[i - 1].node;
+		l = (volatile node_t*) finger.path[i].node;
+		lo = finger.path[i].lo;
+		hi = finger.path[i].hi;
+		count = finger.path[i - 1].count;
+		finger.depth = i;
+	} else {
+		finger.depth = 0;
+		if (l->left) {
+			gp = p;
+			p = l;
+			l = l->left;
+		}
+	}
+	while (l->left) {
+		if (d > 0 && l->rank == p->rank)
+			++count;
+		finger_push(&finger, l, lo, hi, count);
+		gp = p;
+		p = l;
+		if (key < l->key) {
+			hi = l->key;
+			l = l->left;
+		} else {
+			lo = l->key;
+			l = l->right;
+		}
+	}
+	if (gp_ptr)
+		*gp_ptr = gp;
+	*p_ptr = p;
+	*l_ptr = l;
+	return count;
+}
+
 volatile operation_t* weak_llx(volatile node_t* node) {
 	volatile operation_t* node_info = node->op;
 	const int state = node_info->state;
 	if (state == STATE_ABORTED || (state == STATE_COMMITTED && !node->marked)) {
 		return node_info;
 	}
-	if (node_info->state == STATE_INPROGRESS) {
-		help_scx(node_info, 1);
-	} else if (node->op->state == STATE_INPROGRESS) {
-		help_scx(node->op, 1);
+	volatile operation_t* busy = node_info;
+	if (busy->state != STATE_INPROGRESS)
+		busy = node->op;
+	// either way the node is not ready; with MODE_LAZY_HELP its owner gets a
+	// few spins to finish before we help
+	if (busy->state == STATE_INPROGRESS && (!(modes & MODE_LAZY_HELP)
+			|| help_wait(&busy->state, STATE_INPROGRESS))) {
+		STAT_INC(llx_helps);
+		help_scx(busy, 1);
 	}
+	STAT_INC(llx_fails);
 	return null;
 }
 
@@ -189,16 +737,37 @@ bool help_scx(volatile operation_t* op, const int start_index) {
 	// so, we return.
 	if (op->state != STATE_INPROGRESS)
 		return true;
+	if (start_index == 0) {
+		STAT_INC(scx_attempts);
+#ifdef SNAPSHOT_VERSIONS
+		if (modes & MODE_SNAPSHOT) {
+			// the new subtree is not reachable yet, see snapshot.h
+			op->subtree->version = snapshot_tag;
+			op->subtree->replaced = op->nodes[1];
+		}
+#endif
+	}
+
+	// only range ops outgrow their inline arrays, see range_operation_t
+	const int ops_size = op->ops_size;
+	volatile node_t* volatile* nodes = op->nodes;
+	volatile operation_t* volatile* ops = op->ops;
+	if (ops_size > MAX_OPS_SIZE) {
+		nodes = ((volatile range_operation_t*) op)->nodes;
+		ops = ((volatile range_operation_t*) op)->ops;
+	}
 
 	// freeze sub-tree
-	for (int i = start_index; i < op->ops_size; ++i) {
+	for (int i = start_index; i < ops_size; ++i) {
 		// if work was not done
-		if (!AO_compare_and_swap((AO_t*)(&(op->nodes[i]->op)), (AO_t)(op->ops[i]),
-				(AO_t)(op)) && op->nodes[i]->op != op) {
+		if (!AO_compare_and_swap((AO_t*)(&(nodes[i]->op)), (AO_t)(ops[i]),
+				(AO_t)(op)) && nodes[i]->op != op) {
 			if (op->all_frozen) {
 				return true;
 			} else {
 				op->state = STATE_ABORTED;
+				if (start_index == 0)
+					STAT_INC(scx_aborts);
 				// help the garbage collector (must be AFTER we set state
 				// committed or aborted)
 //				clear_op(op);
@@ -207,18 +776,23 @@ bool help_scx(volatile operation_t* op, const int start_index) {
 		}
 	}
 	op->all_frozen = true;
-	for (int i = 1; i < op->ops_size; ++i)
-		op->nodes[i]->marked = true; // finalize all but first node
+	for (int i = 1; i < ops_size; ++i)
+		nodes[i]->marked = true; // finalize all but first node
 
-	// CAS in the new sub-tree (child-cas)
+	// CAS in the new sub-tree (child-cas); only the winner counts the
+	// finalized nodes, which are unlinked by it
 	if (op->nodes[0]->left == op->nodes[1]) {
-		AO_compare_and_swap((AO_t*)(&(op->nodes[0]->left)), (AO_t)(op->nodes[1]),
-				(AO_t)(op->subtree));
+		if (AO_compare_and_swap((AO_t*)(&(op->nodes[0]->left)),
+				(AO_t)(op->nodes[1]), (AO_t)(op->subtree)))
+			MEM_ADD(retired, ops_size - 1);
 	} else { // assert: op->nodes[0].right == op->nodes[1]
-		AO_compare_and_swap((AO_t*)(&(op->nodes[0]->right)), (AO_t)(op->nodes[1]),
-				(AO_t)(op->subtree));
+		if (AO_compare_and_swap((AO_t*)(&(op->nodes[0]->right)),
+				(AO_t)(op->nodes[1]), (AO_t)(op->subtree)))
+			MEM_ADD(retired, ops_size - 1);
 	}
 	op->state = STATE_COMMITTED;
+	if (start_index == 0)
+		STAT_INC(scx_commits);
 
 	// help the garbage collector (must be AFTER we set state committed or
 	// aborted)
@@ -228,20 +802,26 @@ bool help_scx(volatile operation_t* op, const int start_index) {
 
 
 void fix_to_key(const unsigned long key) {
+	FIX_TIMER_START(start);
+	STAT_INC(fix_calls);
 	while (true) {
 		volatile node_t* gp;
 		volatile node_t* p = root;
 		volatile node_t* l = root->left;
 		volatile node_t* ls = root->right;
-		if (l->left == null)
+		if (l->left == null) {
+			FIX_TIMER_STOP(start, fix_ticks);
 			return; // only sentinels in tree...
+		}
 		gp = p;
 		p = l;
 		l = l->left;
 		ls = l->right;
 		while (true) {
-			if (!l->left)
+			if (!l->left) {
+				FIX_TIMER_STOP(start, fix_ticks);
 				return; // if no violation, then the search hit a leaf, so we can stop
+			}
 			gp = p;
 			p = l;
 			l = key < l->key ? l->left : l->right;
@@ -250,26 +830,33 @@ void fix_to_key(const unsigned long key) {
 			if (l->rank == p->rank) {
 				op = create_balancing_operation(gp, p, l);
 				if (op != null) {
-					help_scx(op, 0);
+					if (help_scx(op, 0) && (modes & MODE_RANK))
+						count_update(key, op->subtree);
+				} else {
+					STAT_INC(create_null);
 				}
 				break;
 			} else if (ls && l->rank == p->rank - 1 && ls->rank == p->rank) {
 				op = create_balancing_operation(gp, p, ls);
 				if (op != null) {
-					help_scx(op, 0);
+					if (help_scx(op, 0) && (modes & MODE_RANK))
+						count_update(key, op->subtree);
+				} else {
+					STAT_INC(create_null);
 				}
 				break;
 			}
 
 
 		}
+		STAT_INC(fix_restarts);
 	}
 }
 
 volatile operation_t* create_insert_operation(volatile node_t* p,
 		volatile node_t* l, const unsigned long key) {
 
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = INSERT_OPS_SIZE;
 
@@ -288,13 +875,13 @@ volatile operation_t* create_insert_operation(volatile node_t* p,
 
 	const unsigned long new_rank = is_sentinel(l) ? ULONG_MAX : 0;
 
-	node_t* new_leaf = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_leaf = alloc_node();
 	init_node(new_leaf, key, 0, null, null, dummy);
 
-	node_t* new_l = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_l = alloc_node();
 	init_node(new_l, l->key, new_rank, l->left, l->right, dummy);
 
-	node_t* new_p = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_p = alloc_node();
 	if (key < l->key) {
 		init_node(new_p, l->key, l->rank, new_leaf, new_l, dummy);
 
@@ -306,10 +893,29 @@ volatile operation_t* create_insert_operation(volatile node_t* p,
 	return new_op;
 }
 
+// in MODE_SNAPSHOT, replaces the sibling a removal links in place of its
+// parent by a copy, so that the subtree is a new node that can carry its
+// version (snapshot.h); the sibling is frozen as the last node of op,
+// whose nodes and ops are in the given arrays
+static bool copy_subtree(operation_t* op, volatile node_t** nodes,
+		volatile operation_t** ops) {
+	volatile node_t* s = op->subtree;
+	const int i = op->ops_size;
+	nodes[i] = s;
+	ops[i] = weak_llx(s);
+	if (!ops[i])
+		return false;
+	node_t* new_s = alloc_node();
+	init_node(new_s, s->key, s->rank, s->left, s->right, dummy);
+	op->subtree = new_s;
+	op->ops_size = i + 1;
+	return true;
+}
+
 volatile operation_t* create_remove_operation(volatile node_t* gp,
 		volatile node_t* p, volatile node_t* l) {
 
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = REMOVE_OPS_SIZE;
 
@@ -336,9 +942,68 @@ volatile operation_t* create_remove_operation(volatile node_t* gp,
 		return null;
 
 	new_op->subtree = left ? p->right : p->left;
+	if ((modes & MODE_SNAPSHOT)
+			&& !copy_subtree(new_op, new_op->nodes, new_op->ops))
+		return null;
 	return new_op;
 }
 
+// adds the nodes below n to the removal op in preorder; false if an LLX
+// fails, a leaf is outside [lo, hi] or there are more than
+// RANGE_SUBTREE_MAX of them (*too_big)
+static bool range_collect(range_operation_t* op, volatile node_t* n,
+		const unsigned long lo, const unsigned long hi, bool* too_big) {
+	if (op->op.ops_size == 2 + RANGE_SUBTREE_MAX) {
+		*too_big = true;
+		return false;
+	}
+	const int i = op->op.ops_size++;
+	op->nodes[i] = n;
+	op->ops[i] = weak_llx(n);
+	if (!op->ops[i])
+		return false;
+	if (!n->left)
+		return n->key >= lo && n->key <= hi;
+	return range_collect(op, n->left, lo, hi, too_big)
+			&& range_collect(op, n->right, lo, hi, too_big);
+}
+
+// replaces p by the sibling of x, like a removal of the whole subtree x;
+// all of its nodes are frozen, so nothing enters it before it is gone
+volatile operation_t* create_range_operation(volatile node_t* gp,
+		volatile node_t* p, volatile node_t* x, const unsigned long lo,
+		const unsigned long hi, bool* too_big) {
+	range_operation_t* new_op = alloc_range_op();
+	init_range_op(new_op);
+
+	new_op->nodes[0] = gp;
+	new_op->ops[0] = weak_llx(gp);
+	if (!new_op->ops[0])
+		return null;
+
+	if (p != gp->left && p != gp->right)
+		return null;
+
+	new_op->nodes[1] = p;
+	new_op->ops[1] = weak_llx(p);
+	if (!new_op->ops[1])
+		return null;
+
+	const bool left = x == p->left;
+	if (!left && x != p->right)
+		return null;
+
+	new_op->op.ops_size = 2;
+	if (!range_collect(new_op, x, lo, hi, too_big))
+		return null;
+
+	new_op->op.subtree = left ? p->right : p->left;
+	if ((modes & MODE_SNAPSHOT)
+			&& !copy_subtree(&new_op->op, new_op->nodes, new_op->ops))
+		return null;
+	return range_op_done(new_op);
+}
+
 volatile operation_t* create_balancing_operation(volatile node_t* pz,
 		volatile node_t* z, volatile node_t* x) {
 	volatile operation_t* oppz = weak_llx(pz);
@@ -404,7 +1069,8 @@ volatile operation_t* create_balancing_operation(volatile node_t* pz,
 
 volatile operation_t* create_promote_op(volatile node_t* pz, volatile node_t* z,
 		volatile operation_t* oppz, volatile operation_t* opz, const bool left) {
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	STAT_INC(rebalance[REBALANCE_PROMOTE]);
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = PROMOTE_OPS_SIZE;
 
@@ -415,7 +1081,7 @@ volatile operation_t* create_promote_op(volatile node_t* pz, volatile node_t* z,
 	new_op->ops[1] = opz;
 
 
-	node_t* new_z = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_z = alloc_node();
 	init_node(new_z, z->key, z->rank + 1, z->left, z->right, dummy);
 	new_op->subtree = new_z;
 
@@ -425,7 +1091,8 @@ volatile operation_t* create_promote_op(volatile node_t* pz, volatile node_t* z,
 volatile operation_t* create_rotate1_op(volatile node_t* pz, volatile node_t* z,
 		volatile node_t* x, volatile operation_t* oppz,
 		volatile operation_t* opz, volatile operation_t* opx, const bool left) {
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	STAT_INC(rebalance[REBALANCE_ROTATE1]);
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = ROTATE_OPS_SIZE;
 
@@ -437,8 +1104,8 @@ volatile operation_t* create_rotate1_op(volatile node_t* pz, volatile node_t* z,
 	new_op->ops[1] = opz;
 	new_op->ops[2] = opx;
 
-	node_t* new_z = (node_t*) xmalloc(sizeof(node_t));
-	node_t* new_x = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_z = alloc_node();
+	node_t* new_x = alloc_node();
 	if (left) {
 		init_node(new_z, z->key, z->rank - 1, x->right, z->right, dummy);
 		init_node(new_x, x->key, x->rank, x->left, new_z, dummy);
@@ -454,7 +1121,8 @@ volatile operation_t* create_rotate1_op(volatile node_t* pz, volatile node_t* z,
 volatile operation_t* create_rotate2_op(volatile node_t* pz, volatile node_t* z,
 		volatile node_t* x, volatile operation_t* oppz,
 		volatile operation_t* opz, volatile operation_t* opx, const bool left) {
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	STAT_INC(rebalance[REBALANCE_ROTATE2]);
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = ROTATE_OPS_SIZE;
 
@@ -466,8 +1134,8 @@ volatile operation_t* create_rotate2_op(volatile node_t* pz, volatile node_t* z,
 	new_op->ops[1] = opz;
 	new_op->ops[2] = opx;
 
-	node_t* new_z = (node_t*) xmalloc(sizeof(node_t));
-	node_t* new_x = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_z = alloc_node();
+	node_t* new_x = alloc_node();
 	if (left) {
 		init_node(new_z, z->key, z->rank, x->right, z->right, dummy);
 		init_node(new_x, x->key, x->rank + 1, x->left, new_z, dummy);
@@ -485,7 +1153,8 @@ volatile operation_t* create_double_rotate_op(volatile node_t* pz,
 		volatile operation_t* oppz, volatile operation_t* opz,
 		volatile operation_t* opx, volatile operation_t* opy, const bool left) {
 
-	operation_t* new_op = (operation_t*) xmalloc(sizeof(operation_t));
+	STAT_INC(rebalance[REBALANCE_DOUBLE_ROTATE]);
+	operation_t* new_op = alloc_op();
 	init_op(new_op);
 	new_op->ops_size = DOUBLE_ROTATE_OPS_SIZE;
 
@@ -499,9 +1168,9 @@ volatile operation_t* create_double_rotate_op(volatile node_t* pz,
 	new_op->ops[2] = opx;
 	new_op->ops[3] = opy;
 
-	node_t* new_z = (node_t*) xmalloc(sizeof(node_t));
-	node_t* new_x = (node_t*) xmalloc(sizeof(node_t));
-	node_t* new_y = (node_t*) xmalloc(sizeof(node_t));
+	node_t* new_z = alloc_node();
+	node_t* new_x = alloc_node();
+	node_t* new_y = alloc_node();
 	if (left) {
 		init_node(new_z, z->key, z->rank - 1, y->right, z->right, dummy);
 		init_node(new_x, x->key, x->rank - 1, x->left, y->left, dummy);
@@ -546,6 +1215,76 @@ int height_node(volatile node_t* node) {
 	}
 }
 
+// violations are those on the path down to node
+void stats_node(stats_stack_t* stack, volatile node_t* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s) {
+	volatile node_t* left = node->left;
+	volatile node_t* right = node->right;
+	if (!left) {
+		stats_leaf(s, depth, violations);
+		return;
+	}
+	s->internal++;
+	volatile node_t* children[2] = { left, right };
+	unsigned long below[2] = { violations, violations };
+	for (int i = 0; i < 2; ++i) {
+		volatile node_t* c = children[i];
+		if (!c)
+			continue;
+		const unsigned long gap = node->rank >= c->rank ? node->rank - c->rank : 0;
+		stats_gap(s, gap);
+		if (gap == 0) {
+			stats_violation(s, depth + 1, 1); // 0-child
+			below[i]++;
+		}
+	}
+	if (right)
+		stats_push(stack, right, depth + 1, below[1]);
+	stats_push(stack, left, depth + 1, below[0]);
+}
+
+void stats_walk(stats_stack_t* stack, volatile void* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s) {
+	stats_push(stack, node, depth, violations);
+	while (stack->size) {
+		const stats_entry_t e = stack->entries[--stack->size];
+		stats_node(stack, (volatile node_t*) e.node, e.depth, e.violations, s);
+	}
+}
+
+void tree_stats(tree_stats_t* s, const int nthreads) {
+	volatile node_t* top = root->left->left;
+	if (!top)
+		return;
+	stats_stack_t frontier = { NULL, 0, 0 };
+	stats_push(&frontier, top, 1, 0);
+	// expand the top of the tree breadth-first until every thread has
+	// several subtrees to walk
+	while (nthreads > 1 && frontier.size < nthreads * STATS_SPLIT_FACTOR) {
+		stats_stack_t next = { NULL, 0, 0 };
+		bool expanded = false;
+		for (int i = 0; i < frontier.size; ++i) {
+			volatile node_t* node = (volatile node_t*) frontier.entries[i].node;
+			if (node->left) {
+				stats_node(&next, node, frontier.entries[i].depth,
+						frontier.entries[i].violations, s);
+				expanded = true;
+			} else {
+				stats_push(&next, node, frontier.entries[i].depth,
+						frontier.entries[i].violations);
+			}
+		}
+		free(frontier.entries);
+		frontier = next;
+		if (!expanded)
+			break;
+	}
+	stats_run(&frontier, nthreads > 1 ? nthreads : 1, stats_walk, s);
+	free(frontier.entries);
+}
+
 void print_node(volatile node_t* node) {
 	if (!node)
 		return;
@@ -570,3 +1309,37 @@ void print_tree_node(volatile node_t* node, const int level) {
 	if (node->right)
 		print_tree_node(node->right, level + 1);
 }
+
+// walks every node reachable from the root, sentinels included
+void tree_footprint(mem_footprint_t* m) {
+	stats_stack_t stack = { NULL, 0, 0 };
+	unsigned long* ops = NULL;
+	unsigned long nb_ops = 0, capacity = 0;
+	m->nodes = 0;
+	m->node_size = sizeof(node_t);
+	m->op_size = sizeof(operation_t);
+	stats_push(&stack, root, 0, 0);
+	while (stack.size) {
+		volatile node_t* node = (volatile node_t*) stack.entries[--stack.size].node;
+		m->nodes++;
+		if (nb_ops == capacity) {
+			capacity = capacity ? 2 * capacity : 1024;
+			ops = (unsigned long*) realloc(ops, capacity * sizeof(unsigned long));
+			if (!ops) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		ops[nb_ops++] = (unsigned long) node->op;
+		if (node->left)
+			stats_push(&stack, node->left, 0, 0);
+		if (node->right)
+			stats_push(&stack, node->right, 0, 0);
+	}
+	m->ops = mem_distinct(ops, nb_ops);
+	m->bytes = m->nodes * m->node_size + m->ops * m->op_size;
+	m->aux_bytes = (modes & MODE_CACHE ? sizeof(cache_t) : 0)
+			+ (modes & MODE_BLOOM ? bloom_bytes(&bloom) : 0);
+	free(ops);
+	free(stack.entries);
+}
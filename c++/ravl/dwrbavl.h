@@ -11,6 +11,12 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <jemalloc/jemalloc.h>
+#include "../scx_stats.h"
+#include "../mem_stats.h"
+#include "../finger.h"
+#include "../modes.h"
+#include "../rank.h"
+#include "../tree_stats.h"
 
 #define true 					1
 #define false 					0
@@ -29,39 +35,14 @@
 #define PROMOTE_OPS_SIZE		2
 #define ROTATE_OPS_SIZE			3
 #define DOUBLE_ROTATE_OPS_SIZE	4
+#define RANGE_SUBTREE_MAX		128 // subtree nodes one SCX of delete_range freezes
+#define RANGE_OPS_SIZE			(RANGE_SUBTREE_MAX + 3)
 #define MAX_OPS_SIZE			4
 
-typedef struct barrier {
-	pthread_cond_t complete;
-	pthread_mutex_t mutex;
-	int count;
-	int crossing;
-} barrier_t;
-
-typedef struct thread_data {
-  unsigned long first;
-  unsigned long range;
-  int update;
-  int insert;
-  int alternate;
-  int effective;
-  int id;
-  unsigned long numThreads;
-  unsigned long nb_add;
-  unsigned long nb_added;
-  unsigned long nb_remove;
-  unsigned long nb_removed;
-  unsigned long nb_contains;
-  unsigned long nb_found;
-  unsigned long ops;
-  unsigned int seed;
-  double search_frac;
-  double insert_frac;
-  double delete_frac;
-  unsigned long keyspace1_size;
-  barrier_t *barrier;
-
-} thread_data_t;
+#define REBALANCE_PROMOTE		0
+#define REBALANCE_ROTATE1		1
+#define REBALANCE_ROTATE2		2
+#define REBALANCE_DOUBLE_ROTATE	3
 
 inline void *xmalloc(size_t size) {
   void *p = malloc(size);
@@ -79,6 +60,13 @@ struct node {
 	volatile struct operation* op;
 	volatile bool marked;
 	unsigned long rank;
+#ifdef RANK_COUNTS
+	volatile unsigned long count; // keys below, see rank.h
+#endif
+#ifdef SNAPSHOT_VERSIONS
+	unsigned long version;        // tag of the update that linked it, see snapshot.h
+	volatile struct node* replaced; // the child it replaced, see snapshot.h
+#endif
 };
 
 struct operation {
@@ -93,18 +81,79 @@ struct operation {
 typedef struct node node_t;
 typedef struct operation operation_t;
 
+// a removal op of delete_range, which may freeze more than MAX_OPS_SIZE
+// nodes; past that help_scx finds them here instead of in op, see
+// range_op_done
+typedef struct range_operation {
+	operation_t op;
+	volatile node_t* nodes[RANGE_OPS_SIZE];
+	volatile operation_t* ops[RANGE_OPS_SIZE];
+} range_operation_t;
+
+static inline node_t* alloc_node() {
+	MEM_INC(nodes);
+	return (node_t*) xmalloc(sizeof(node_t));
+}
+
+static inline operation_t* alloc_op() {
+	MEM_INC(ops);
+	return (operation_t*) xmalloc(sizeof(operation_t));
+}
+
+static inline range_operation_t* alloc_range_op() {
+	MEM_INC(ops);
+	return (range_operation_t*) xmalloc(sizeof(range_operation_t));
+}
+
+// keys below n, 0 for null
+static inline unsigned long keys_below(volatile node_t* n) {
+#ifdef RANK_COUNTS
+	return n ? COUNT_KEYS(n->count) : 0;
+#else
+	return 0;
+#endif
+}
+
+// child c of a node as it was in the snapshot of version v
+static inline volatile node_t* snapshot_child(volatile node_t* c,
+		const unsigned long v) {
+#ifdef SNAPSHOT_VERSIONS
+	while (c && c->version > v)
+		c = c->replaced;
+#endif
+	return c;
+}
+
 int init_node(node_t* node_ptr, const unsigned long key, const unsigned long rank, volatile node_t* left, volatile node_t* right,
 		volatile operation_t* op);
 bool is_sentinel(volatile node_t* node);
 int init_dummy_op(volatile operation_t* op_ptr);
 int init_op(operation_t* op_ptr);
+void init_range_op(range_operation_t* op_ptr);
 void clear_op(volatile operation_t* op_ptr);
 
 int init_tree(const int all_violation_per_path);
+void set_modes(const int m);
+void reserve(const unsigned long keys, const unsigned long range);
+bool leaf_in_tree(volatile node_t* p, volatile node_t* l);
+bool eliminate(const unsigned long key, const int type, volatile node_t* l);
+bool append_search(const unsigned long key, volatile node_t** p_ptr,
+		volatile node_t** l_ptr);
+int finger_search(const unsigned long key, volatile node_t** gp_ptr,
+		volatile node_t** p_ptr, volatile node_t** l_ptr);
 int tree_size();
 bool get(const unsigned long key);
 bool insert(const unsigned long key);
 bool delete(const unsigned long key);
+bool insert_key(const unsigned long key);
+bool delete_key(const unsigned long key);
+unsigned long delete_range(const unsigned long lo, const unsigned long hi);
+unsigned long delete_range_keys(const unsigned long lo, const unsigned long hi);
+void count_update(const unsigned long key, volatile node_t* subtree);
+unsigned long key_rank(const unsigned long key);
+bool key_select(const unsigned long i, unsigned long* key);
+unsigned long scan(const unsigned long lo, const unsigned long hi,
+		void (*visit)(const unsigned long key, void* arg), void* arg);
 int sequential_size(volatile node_t* node);
 volatile operation_t* weak_llx(volatile node_t* node_ptr);
 bool weak_llx_array(volatile node_t* node_ptr, const int i,
@@ -112,10 +161,14 @@ bool weak_llx_array(volatile node_t* node_ptr, const int i,
 bool help_scx(volatile operation_t* op, const int start_index);
 
 void fix_to_key(const unsigned long key);
+extern __thread unsigned long fix_ticks;
 volatile operation_t* create_insert_operation(volatile node_t* p,
 		volatile node_t* l, const unsigned long key);
 volatile operation_t* create_remove_operation(volatile node_t* gp,
 		volatile node_t* p, volatile node_t* l);
+volatile operation_t* create_range_operation(volatile node_t* gp,
+		volatile node_t* p, volatile node_t* x, const unsigned long lo,
+		const unsigned long hi, bool* too_big);
 volatile operation_t* create_balancing_operation(volatile node_t* pz,
 		volatile node_t* z, volatile node_t* x);
 volatile operation_t* create_promote_op(volatile node_t* pz, volatile node_t* z,
@@ -137,6 +190,13 @@ bool can_promote(const volatile node_t* pz, const volatile node_t* z,
 
 int height();
 int height_node(volatile node_t* node);
+void stats_node(stats_stack_t* stack, volatile node_t* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s);
+void stats_walk(stats_stack_t* stack, volatile void* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s);
+void tree_footprint(mem_footprint_t* m);
 void print_node(volatile node_t* node);
 void print_tree();
 void print_tree_node();
@@ -0,0 +1,40 @@
+/*
+ * engine.c
+ *
+ *  engine_t of the relaxed AVL tree for the benchmark driver. Linked with
+ *  dwrbavl.o into ravl_engine.o, in which every other symbol is local.
+ */
+
+#include <string.h>
+#include "dwrbavl.h"
+#include "../engine.h"
+#include "../snapshot.h"
+
+static unsigned long* ravl_fix_ticks() {
+	return &fix_ticks;
+}
+
+static void ravl_scx_stats(scx_stats_t* s) {
+#ifdef SCX_STATS
+	*s = scx_stats;
+#else
+	memset(s, 0, sizeof(scx_stats_t));
+#endif
+}
+
+static void ravl_mem_stats(mem_stats_t* s) {
+#ifdef MEM_STATS
+	*s = mem_stats;
+#else
+	memset(s, 0, sizeof(mem_stats_t));
+#endif
+}
+
+const engine_t ravl_engine = { "dwrbavl", true, init_tree, get, insert, delete,
+		height, tree_size, ravl_fix_ticks, ravl_scx_stats, tree_stats,
+		rebalance_names, &stats_gap_name, ravl_mem_stats, tree_footprint,
+		MODE_FINGER | MODE_APPEND | MODE_ELIM | MODE_COMBINE
+			| MODE_BACKOFF | MODE_LAZY_HELP | MODE_CACHE | MODE_BLOOM
+			| RANK_MODES | MODE_SIZE | SNAPSHOT_MODES,
+		set_modes, reserve, key_rank, key_select, scan,
+		delete_range };
@@ -0,0 +1,125 @@
+/*
+ * replay.h
+ *
+ *  Operation recording for deterministic replays. Every worker appends
+ *  the operations it issues, with the TSC time since it crossed the
+ *  start barrier, to its own op_record_t. The records are saved as a
+ *  trace file (trace.h) with the sections
+ *
+ *    prefill          keys inserted before the run (TRACE_KEYS)
+ *    thread<i>/ops    operations of thread i, packed as in workload.h
+ *    thread<i>/time   issue time of each operation in ns (TRACE_KEYS)
+ *
+ *  and replayed by mapping those sections directly.
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct op_record {
+	unsigned long* ops;
+	unsigned long* times;
+	unsigned long size;
+	unsigned long capacity;
+	unsigned long start; // TSC at the start barrier
+} op_record_t;
+
+static inline void rec_init(op_record_t* r, const unsigned long capacity) {
+	r->size = 0;
+	r->capacity = capacity > 0 ? capacity : 1024;
+	r->ops = (unsigned long*) malloc(r->capacity * sizeof(unsigned long));
+	r->times = (unsigned long*) malloc(r->capacity * sizeof(unsigned long));
+	r->start = 0;
+	if (!r->ops || !r->times) {
+		perror("malloc");
+		exit(1);
+	}
+}
+
+static inline void rec_free(op_record_t* r) {
+	free(r->ops);
+	free(r->times);
+}
+
+static inline void rec_grow(op_record_t* r) {
+	if (r->size < r->capacity)
+		return;
+	r->capacity *= 2;
+	r->ops = (unsigned long*) realloc(r->ops,
+			r->capacity * sizeof(unsigned long));
+	r->times = (unsigned long*) realloc(r->times,
+			r->capacity * sizeof(unsigned long));
+	if (!r->ops || !r->times) {
+		perror("realloc");
+		exit(1);
+	}
+}
+
+static inline void rec_append(op_record_t* r, const int op,
+		const unsigned long key) {
+	rec_grow(r);
+	r->ops[r->size] = stream_pack(op, key);
+	r->times[r->size] = read_tsc() - r->start;
+	r->size++;
+}
+
+// plain key, for the prefill record
+static inline void rec_key(op_record_t* r, const unsigned long key) {
+	rec_grow(r);
+	r->ops[r->size] = key;
+	r->times[r->size] = 0;
+	r->size++;
+}
+
+// converts the record times to ns and writes a fresh trace file
+static inline void rec_write(const char* path, op_record_t* recs,
+		const int nthreads, const op_record_t* prefill,
+		const double ticks_per_ns) {
+	trace_input_t* in = (trace_input_t*) malloc(
+			(2 * nthreads + 1) * sizeof(trace_input_t));
+	char (*names)[TRACE_NAME_LEN] = (char (*)[TRACE_NAME_LEN]) malloc(
+			2 * nthreads * TRACE_NAME_LEN);
+	if (!in || !names) {
+		perror("malloc");
+		exit(1);
+	}
+	if (2 * nthreads + 1 > TRACE_MAX_SECTIONS) {
+		fprintf(stderr, "too many threads to record\n");
+		exit(1);
+	}
+	trace_input_t p = { "prefill", TRACE_KEYS, prefill->ops, prefill->size };
+	in[0] = p;
+	for (int i = 0; i < nthreads; ++i) {
+		for (unsigned long j = 0; j < recs[i].size; ++j)
+			recs[i].times[j] = (unsigned long) (recs[i].times[j] / ticks_per_ns);
+		snprintf(names[2 * i], TRACE_NAME_LEN, "thread%d/ops", i);
+		snprintf(names[2 * i + 1], TRACE_NAME_LEN, "thread%d/time", i);
+		trace_input_t o = { names[2 * i], TRACE_OPS, recs[i].ops, recs[i].size };
+		trace_input_t t = { names[2 * i + 1], TRACE_KEYS, recs[i].times,
+				recs[i].size };
+		in[2 * i + 1] = o;
+		in[2 * i + 2] = t;
+	}
+	unlink(path);
+	trace_write(path, in, 2 * nthreads + 1);
+	free(names);
+	free(in);
+}
+
+// number of threads recorded in t
+static inline int replay_threads(const trace_t* t) {
+	char name[TRACE_NAME_LEN];
+	int n = 0;
+	while (true) {
+		snprintf(name, sizeof(name), "thread%d/ops", n);
+		if (!trace_section(t, name))
+			return n;
+		++n;
+	}
+}
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,121 @@
+/*
+ * sampler.h
+ *
+ *  Time series of a run: a sampler thread reads one cache line padded
+ *  operation and key counter per worker every interval ms and prints the
+ *  throughput of the last interval, the tree height, the resident set
+ *  size and the resident bytes per key. The key count comes from the
+ *  worker counters rather than the set, so sampling never freezes the
+ *  updaters (as an exact size does) and never walks the tree; the height
+ *  is a full walk, so it is only sampled when asked for.
+ */
+
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE			64
+
+// written only by its worker, so workers never share the line
+typedef struct progress {
+	volatile unsigned long ops;
+	volatile long keys;       // keys added net of the keys removed
+	char pad[CACHE_LINE_SIZE - sizeof(unsigned long) - sizeof(long)];
+} __attribute__((aligned(CACHE_LINE_SIZE))) progress_t;
+
+typedef struct sampler {
+	const progress_t* progress;
+	int nthreads;
+	int interval;             // ms
+	int (*height)();          // null to leave the height out (printed as 0)
+	long keys;                // set size when the workers started
+	volatile unsigned long* warmup_done; // phase of each sample, may be null
+	FILE* f;
+	char label[64];
+	volatile int stop;
+	pthread_t thread;
+} sampler_t;
+
+static inline progress_t* progress_alloc(const int nthreads) {
+	void* p;
+	if (posix_memalign(&p, CACHE_LINE_SIZE, nthreads * sizeof(progress_t)) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+	for (int i = 0; i < nthreads; ++i) {
+		((progress_t*) p)[i].ops = 0;
+		((progress_t*) p)[i].keys = 0;
+	}
+	return (progress_t*) p;
+}
+
+// resident set size in KiB, 0 if /proc is not available
+static inline unsigned long rss_kb() {
+	unsigned long pages = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%lu %lu", &pages, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static inline double sampler_ms(const struct timeval* a, const struct timeval* b) {
+	return (b->tv_sec - a->tv_sec) * 1000.0 + (b->tv_usec - a->tv_usec) / 1000.0;
+}
+
+// series,<label>,<ms>,<phase>,<ops/s>,<height>,<rss KiB>,<rss bytes/key>
+static void* sampler_run(void* arg) {
+	sampler_t* s = (sampler_t*) arg;
+	struct timeval start, last, now;
+	unsigned long last_ops = 0;
+	const struct timespec pause = { s->interval / 1000,
+			(s->interval % 1000) * 1000000L };
+	gettimeofday(&start, NULL);
+	last = start;
+	while (!s->stop) {
+		nanosleep(&pause, NULL);
+		if (s->stop)
+			break;
+		unsigned long ops = 0;
+		long keys = s->keys;
+		for (int i = 0; i < s->nthreads; ++i) {
+			ops += s->progress[i].ops;
+			keys += s->progress[i].keys;
+		}
+		gettimeofday(&now, NULL);
+		const double elapsed = sampler_ms(&last, &now);
+		const unsigned long rss = rss_kb();
+		fprintf(s->f, "series,%s,%.0f,%s,%.2f,%d,%lu,%.1f\n", s->label,
+				sampler_ms(&start, &now),
+				s->warmup_done && !*s->warmup_done ? "warmup" : "run",
+				elapsed > 0 ? (ops - last_ops) * 1000.0 / elapsed : 0,
+				s->height ? s->height() : 0, rss,
+				keys > 0 ? rss * 1024.0 / keys : 0);
+		last_ops = ops;
+		last = now;
+	}
+	return NULL;
+}
+
+static inline void sampler_start(sampler_t* s) {
+	s->stop = 0;
+	if (pthread_create(&s->thread, NULL, sampler_run, s) != 0) {
+		perror("error creating sampler thread");
+		exit(1);
+	}
+}
+
+static inline void sampler_stop(sampler_t* s) {
+	s->stop = 1;
+	pthread_join(s->thread, NULL);
+}
+
+#endif /* SAMPLER_H_ */
@@ -0,0 +1,87 @@
+/*
+ * scx_stats.h
+ *
+ *  Per-thread LLX/SCX event counters. Compiled in only with -DSCX_STATS
+ *  (make SCX_STATS=1); otherwise STAT_INC expands to nothing.
+ */
+
+#ifndef SCX_STATS_H_
+#define SCX_STATS_H_
+
+#include <stdio.h>
+
+#define MAX_REBALANCE_TYPES		16
+
+typedef struct scx_stats {
+	unsigned long scx_attempts; // help_scx called by the owner of the operation
+	unsigned long scx_commits;
+	unsigned long scx_aborts;
+	unsigned long llx_helps;    // weak_llx found an in-progress op and helped it
+	unsigned long llx_fails;    // weak_llx returned null
+	unsigned long create_null;  // create_* returned null, search restarted
+	unsigned long fix_calls;
+	unsigned long fix_restarts; // extra passes of the fix_to_key outer loop
+	unsigned long elim_offers;  // updates offered for elimination
+	unsigned long elim_hits;    // updates completed by elimination
+	unsigned long backoffs;     // waits after a failed attempt (backoff.h)
+	unsigned long backoff_spins;
+	unsigned long help_waits;   // weak_llx waited for the owner before helping
+	unsigned long help_skips;   // the owner finished within the wait
+	unsigned long cache_hits;   // gets answered from the cache (cache.h)
+	unsigned long cache_misses;
+	unsigned long bloom_negatives; // gets answered by the filter (bloom.h)
+	unsigned long bloom_false_positives; // gets the filter let through in vain
+	unsigned long count_restarts; // count refreshes that lost their path (rank.h)
+	unsigned long rebalance[MAX_REBALANCE_TYPES];
+} scx_stats_t;
+
+#ifdef SCX_STATS
+extern __thread scx_stats_t scx_stats;
+#define STAT_ADD(field, n)		(scx_stats.field += (n))
+#else
+#define STAT_ADD(field, n)		do {} while (0)
+#endif
+#define STAT_INC(field)			STAT_ADD(field, 1)
+
+// defined by each tree, null terminated
+extern const char* rebalance_names[];
+
+static inline void scx_stats_merge(scx_stats_t* dst, const scx_stats_t* src) {
+	const unsigned long* s = (const unsigned long*) src;
+	unsigned long* t = (unsigned long*) dst;
+	for (int i = 0; i < sizeof(scx_stats_t) / sizeof(unsigned long); ++i)
+		t[i] += s[i];
+}
+
+static inline void scx_stats_print(FILE* f, const scx_stats_t* s,
+		const unsigned long ops, const char** names) {
+	const double n = ops ? (double) ops : 1;
+	fprintf(f, "scx,attempts=%lu,commits=%lu,aborts=%lu,abort_rate=%.4f,"
+			"llx_helps=%lu(%.4f/op),llx_fails=%lu,create_null=%lu(%.4f/op),"
+			"fix_calls=%lu,fix_restarts=%lu(%.4f/fix),elim_offers=%lu,"
+			"elim_hits=%lu(%.4f/op),backoffs=%lu,backoff_spins=%lu(%.1f/backoff),"
+			"help_waits=%lu,help_skips=%lu,cache_hits=%lu,cache_misses=%lu,"
+			"cache_hit_rate=%.4f,bloom_negatives=%lu,bloom_false_positives=%lu,"
+			"bloom_fpr=%.4f,count_restarts=%lu", s->scx_attempts,
+			s->scx_commits, s->scx_aborts,
+			s->scx_attempts ? (double) s->scx_aborts / s->scx_attempts : 0,
+			s->llx_helps, s->llx_helps / n, s->llx_fails, s->create_null,
+			s->create_null / n, s->fix_calls, s->fix_restarts,
+			s->fix_calls ? (double) s->fix_restarts / s->fix_calls : 0,
+			s->elim_offers, s->elim_hits, s->elim_hits / n, s->backoffs,
+			s->backoff_spins,
+			s->backoffs ? (double) s->backoff_spins / s->backoffs : 0,
+			s->help_waits, s->help_skips, s->cache_hits, s->cache_misses,
+			s->cache_hits + s->cache_misses ?
+					(double) s->cache_hits / (s->cache_hits + s->cache_misses) : 0,
+			s->bloom_negatives, s->bloom_false_positives,
+			s->bloom_negatives + s->bloom_false_positives ?
+					(double) s->bloom_false_positives
+							/ (s->bloom_negatives + s->bloom_false_positives) : 0,
+			s->count_restarts);
+	for (int i = 0; names && names[i]; ++i)
+		fprintf(f, ",%s=%lu", names[i], s->rebalance[i]);
+	fprintf(f, "\n");
+}
+
+#endif /* SCX_STATS_H_ */
@@ -0,0 +1,48 @@
+/*
+ * snapshot.h
+ *
+ *  Versions for snapshot scans of the trees (MODE_SNAPSHOT). An update
+ *  registers in the key counter (counter.h) and keeps the snapshot version
+ *  it read on entry as its tag; an SCX it commits stamps the root of the
+ *  new subtree with the tag and with the node the subtree replaced.
+ *  snapshot_begin holds off updates like counter_exact, waits for the
+ *  registered ones and moves the version on, so every commit tagged with
+ *  the version it returns or an older one is in the tree and every later
+ *  commit carries a newer tag. Nodes are never freed: a scan of version v
+ *  follows a child stamped after v back through the nodes it replaced to
+ *  the child it had at the snapshot. Only the start of a scan waits for
+ *  updates; the scan itself runs beside them, and scans do not wait for
+ *  each other.
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include "atomic_ops.h"
+#include "counter.h"
+
+// the version fields of the nodes are compiled in only with
+// make SNAPSHOT_VERSIONS=1; engines offer MODE_SNAPSHOT only then
+#ifdef SNAPSHOT_VERSIONS
+#define SNAPSHOT_MODES			MODE_SNAPSHOT
+#else
+#define SNAPSHOT_MODES			0
+#endif
+
+static __thread unsigned long snapshot_tag = 0; // version of this thread's update
+
+static inline void snapshot_enter(counter_t* c, volatile unsigned long* version) {
+	counter_enter(c);
+	snapshot_tag = *version;
+}
+
+// the version of a snapshot of the set as of now
+static inline unsigned long snapshot_begin(counter_t* c,
+		volatile unsigned long* version) {
+	counter_freeze(c);
+	const unsigned long v = AO_fetch_and_add_full((AO_t*) version, 1);
+	counter_thaw(c);
+	return v;
+}
+
+#endif /* SNAPSHOT_H_ */
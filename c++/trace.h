@@ -0,0 +1,204 @@
+/*
+ * trace.h
+ *
+ *  Binary trace files, mapped read-only and used in place. A file holds
+ *  any number of named sections, each an array of 64-bit words: plain
+ *  keys (TRACE_KEYS) or keys packed with their operation type in the top
+ *  bits as in workload.h (TRACE_OPS).
+ *
+ *  Layout: trace_header_t, then header.sections trace_section_t entries,
+ *  then the section arrays, each starting on a TRACE_ALIGN boundary.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC				"BSTTRACE"
+#define TRACE_VERSION			1
+#define TRACE_NAME_LEN			48
+#define TRACE_ALIGN				64
+#define TRACE_MAX_SECTIONS		256
+
+#define TRACE_KEYS				0
+#define TRACE_OPS				1
+
+typedef struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t sections;
+} trace_header_t;
+
+typedef struct trace_section {
+	char name[TRACE_NAME_LEN];
+	uint32_t kind;
+	uint32_t reserved;
+	uint64_t count;  // number of 64-bit words
+	uint64_t offset; // from the start of the file
+} trace_section_t;
+
+typedef struct trace {
+	void* base;
+	size_t size;
+	const trace_header_t* header;
+	const trace_section_t* sections;
+} trace_t;
+
+// maps path; returns false (with a message) if it is not a trace file
+static inline bool trace_open(trace_t* t, const char* path) {
+	struct stat st;
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(trace_header_t)) {
+		close(fd);
+		fprintf(stderr, "%s: not a trace file\n", path);
+		return false;
+	}
+	t->size = st.st_size;
+	t->base = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (t->base == MAP_FAILED) {
+		perror(path);
+		return false;
+	}
+	t->header = (const trace_header_t*) t->base;
+	t->sections = (const trace_section_t*) (t->header + 1);
+	if (memcmp(t->header->magic, TRACE_MAGIC, 8) != 0
+			|| t->header->version != TRACE_VERSION
+			|| sizeof(trace_header_t)
+					+ t->header->sections * sizeof(trace_section_t) > t->size) {
+		fprintf(stderr, "%s: not a trace file\n", path);
+		munmap(t->base, t->size);
+		return false;
+	}
+	return true;
+}
+
+static inline void trace_close(trace_t* t) {
+	munmap(t->base, t->size);
+}
+
+static inline const trace_section_t* trace_section(const trace_t* t,
+		const char* name) {
+	for (int i = 0; i < t->header->sections; ++i)
+		if (strncmp(t->sections[i].name, name, TRACE_NAME_LEN) == 0)
+			return &t->sections[i];
+	return NULL;
+}
+
+// the words of section name, or NULL if the file does not have it
+static inline const unsigned long* trace_find(const trace_t* t,
+		const char* name, unsigned long* count) {
+	const trace_section_t* s = trace_section(t, name);
+	if (!s || s->offset + s->count * sizeof(uint64_t) > t->size)
+		return NULL;
+	*count = s->count;
+	return (const unsigned long*) ((const char*) t->base + s->offset);
+}
+
+// as trace_find, but exits if the section is missing
+static inline unsigned long* trace_require(const trace_t* t, const char* name,
+		unsigned long* count) {
+	const unsigned long* data = trace_find(t, name, count);
+	if (!data) {
+		fprintf(stderr, "trace section %s not found\n", name);
+		exit(1);
+	}
+	return (unsigned long*) data;
+}
+
+// contiguous share of thread id out of nthreads, without copying
+static inline const unsigned long* trace_slice(const unsigned long* data,
+		const unsigned long count, const int id, const int nthreads,
+		unsigned long* len) {
+	const unsigned long begin = count * id / nthreads;
+	const unsigned long end = count * (id + 1) / nthreads;
+	*len = end - begin;
+	return data + begin;
+}
+
+typedef struct trace_input {
+	const char* name;
+	uint32_t kind;
+	const unsigned long* data;
+	unsigned long count;
+} trace_input_t;
+
+// writes the given sections to path, keeping the sections of an existing
+// trace file there unless they are replaced by name
+static inline void trace_write(const char* path, const trace_input_t* in,
+		const int n) {
+	trace_input_t all[TRACE_MAX_SECTIONS];
+	int total = 0;
+	trace_t old;
+	const bool have_old = access(path, F_OK) == 0 && trace_open(&old, path);
+	if (have_old) {
+		for (int i = 0; i < old.header->sections && total < TRACE_MAX_SECTIONS; ++i) {
+			const trace_section_t* s = &old.sections[i];
+			bool replaced = false;
+			for (int j = 0; j < n; ++j)
+				replaced |= strncmp(s->name, in[j].name, TRACE_NAME_LEN) == 0;
+			if (replaced)
+				continue;
+			all[total].name = s->name;
+			all[total].kind = s->kind;
+			all[total].data = trace_find(&old, s->name, &all[total].count);
+			if (all[total].data)
+				total++;
+		}
+	}
+	for (int j = 0; j < n && total < TRACE_MAX_SECTIONS; ++j)
+		all[total++] = in[j];
+
+	// write next to path, then rename, so the old mapping stays valid
+	char tmp[4096];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE* f = fopen(tmp, "wb");
+	if (!f) {
+		perror(tmp);
+		exit(1);
+	}
+	trace_header_t h;
+	memcpy(h.magic, TRACE_MAGIC, 8);
+	h.version = TRACE_VERSION;
+	h.sections = total;
+	fwrite(&h, sizeof(h), 1, f);
+	uint64_t offset = sizeof(h) + total * sizeof(trace_section_t);
+	for (int i = 0; i < total; ++i) {
+		trace_section_t s;
+		memset(&s, 0, sizeof(s));
+		strncpy(s.name, all[i].name, TRACE_NAME_LEN - 1);
+		s.kind = all[i].kind;
+		s.count = all[i].count;
+		s.offset = (offset + TRACE_ALIGN - 1) / TRACE_ALIGN * TRACE_ALIGN;
+		offset = s.offset + s.count * sizeof(uint64_t);
+		fwrite(&s, sizeof(s), 1, f);
+	}
+	static const char zeros[TRACE_ALIGN];
+	long pos = ftell(f);
+	for (int i = 0; i < total; ++i) {
+		const long aligned = (pos + TRACE_ALIGN - 1) / TRACE_ALIGN * TRACE_ALIGN;
+		fwrite(zeros, 1, aligned - pos, f);
+		fwrite(all[i].data, sizeof(uint64_t), all[i].count, f);
+		pos = aligned + all[i].count * sizeof(uint64_t);
+	}
+	if (fclose(f) != 0 || rename(tmp, path) != 0) {
+		perror(path);
+		exit(1);
+	}
+	if (have_old)
+		trace_close(&old);
+}
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,250 @@
+/*
+ * tree_stats.h
+ *
+ *  Tree shape statistics: leaf depth distribution, balance violations per
+ *  level and on the worst root-to-leaf path, and a histogram of rank gaps (RAVL) or weights (chromatic).
+ *  Each tree implements tree_stats() with an explicit stack, so the pass
+ *  does not recurse, and may split the top of the tree across threads.
+ *  The pass only reads child pointers and may run concurrently with
+ *  updates, in which case the result is approximate.
+ */
+
+#ifndef TREE_STATS_H_
+#define TREE_STATS_H_
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define STATS_MAX_DEPTH			1024 // deeper leaves are counted in the last level
+#define STATS_MAX_GAP			8    // larger gaps are counted in the last bucket
+#define STATS_SPLIT_FACTOR		8    // subtrees handed out per stats thread
+
+typedef struct tree_stats {
+	unsigned long leaves;
+	unsigned long internal;
+	unsigned long depth_sum;
+	unsigned long max_depth;
+	unsigned long violations;
+	unsigned long path_violations; // most on one root-to-leaf path
+	unsigned long depth_hist[STATS_MAX_DEPTH];
+	unsigned long level_violations[STATS_MAX_DEPTH];
+	unsigned long gap_hist[STATS_MAX_GAP];
+} tree_stats_t;
+
+typedef struct stats_entry {
+	volatile void* node;
+	unsigned long depth;
+	unsigned long violations; // on the path down to node
+} stats_entry_t;
+
+typedef struct stats_stack {
+	stats_entry_t* entries;
+	unsigned long size;
+	unsigned long capacity;
+} stats_stack_t;
+
+// accounts a subtree into s; implemented by each tree
+typedef void (*stats_walk_fn)(stats_stack_t* stack, volatile void* node,
+		const unsigned long depth, const unsigned long violations,
+		tree_stats_t* s);
+
+void tree_stats(tree_stats_t* s, const int nthreads);
+extern const char* stats_gap_name; // "rank_gap" or "weight"
+
+static inline void stats_clear(tree_stats_t* s) {
+	memset(s, 0, sizeof(tree_stats_t));
+}
+
+static inline void stats_push(stats_stack_t* st, volatile void* node,
+		const unsigned long depth, const unsigned long violations) {
+	if (st->size == st->capacity) {
+		st->capacity = st->capacity ? st->capacity * 2 : 256;
+		st->entries = (stats_entry_t*) realloc(st->entries,
+				st->capacity * sizeof(stats_entry_t));
+		if (!st->entries) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	st->entries[st->size].node = node;
+	st->entries[st->size].depth = depth;
+	st->entries[st->size].violations = violations;
+	st->size++;
+}
+
+static inline void stats_leaf(tree_stats_t* s, const unsigned long depth,
+		const unsigned long violations) {
+	s->leaves++;
+	s->depth_sum += depth;
+	if (depth > s->max_depth)
+		s->max_depth = depth;
+	if (violations > s->path_violations)
+		s->path_violations = violations;
+	s->depth_hist[depth < STATS_MAX_DEPTH ? depth : STATS_MAX_DEPTH - 1]++;
+}
+
+static inline void stats_violation(tree_stats_t* s, const unsigned long depth,
+		const unsigned long amount) {
+	s->violations += amount;
+	s->level_violations[depth < STATS_MAX_DEPTH ? depth : STATS_MAX_DEPTH - 1] +=
+			amount;
+}
+
+static inline void stats_gap(tree_stats_t* s, const unsigned long gap) {
+	s->gap_hist[gap < STATS_MAX_GAP ? gap : STATS_MAX_GAP - 1]++;
+}
+
+static inline void stats_merge(tree_stats_t* dst, const tree_stats_t* src) {
+	dst->leaves += src->leaves;
+	dst->internal += src->internal;
+	dst->depth_sum += src->depth_sum;
+	dst->violations += src->violations;
+	if (src->max_depth > dst->max_depth)
+		dst->max_depth = src->max_depth;
+	if (src->path_violations > dst->path_violations)
+		dst->path_violations = src->path_violations;
+	for (int i = 0; i < STATS_MAX_DEPTH; ++i) {
+		dst->depth_hist[i] += src->depth_hist[i];
+		dst->level_violations[i] += src->level_violations[i];
+	}
+	for (int i = 0; i < STATS_MAX_GAP; ++i)
+		dst->gap_hist[i] += src->gap_hist[i];
+}
+
+typedef struct stats_job {
+	stats_entry_t* subtrees;
+	unsigned long count;
+	volatile unsigned long next;
+	stats_walk_fn walk;
+} stats_job_t;
+
+typedef struct stats_worker {
+	stats_job_t* job;
+	tree_stats_t result;
+} stats_worker_t;
+
+static void* stats_worker_run(void* arg) {
+	stats_worker_t* w = (stats_worker_t*) arg;
+	stats_stack_t stack = { NULL, 0, 0 };
+	stats_clear(&w->result);
+	while (true) {
+		const unsigned long i = __sync_fetch_and_add(&w->job->next, 1);
+		if (i >= w->job->count)
+			break;
+		w->job->walk(&stack, w->job->subtrees[i].node,
+				w->job->subtrees[i].depth, w->job->subtrees[i].violations,
+				&w->result);
+	}
+	free(stack.entries);
+	return NULL;
+}
+
+// walks every subtree of frontier with nthreads threads and adds the
+// results to s
+static inline void stats_run(stats_stack_t* frontier, const int nthreads,
+		stats_walk_fn walk, tree_stats_t* s) {
+	stats_job_t job = { frontier->entries, frontier->size, 0, walk };
+	stats_worker_t* workers = (stats_worker_t*) malloc(
+			nthreads * sizeof(stats_worker_t));
+	pthread_t* threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+	if (!workers || !threads) {
+		perror("malloc");
+		exit(1);
+	}
+	for (int i = 0; i < nthreads; ++i) {
+		workers[i].job = &job;
+		if (i > 0 && pthread_create(&threads[i], NULL, stats_worker_run,
+				&workers[i]) != 0) {
+			perror("error creating stats thread");
+			exit(1);
+		}
+	}
+	stats_worker_run(&workers[0]);
+	stats_merge(s, &workers[0].result);
+	for (int i = 1; i < nthreads; ++i) {
+		pthread_join(threads[i], NULL);
+		stats_merge(s, &workers[i].result);
+	}
+	free(threads);
+	free(workers);
+}
+
+static inline unsigned long stats_depth_percentile(const tree_stats_t* s,
+		const double p) {
+	unsigned long rank = (unsigned long) (p / 100 * s->leaves + 0.5);
+	if (rank < 1)
+		rank = 1;
+	unsigned long seen = 0;
+	for (int i = 0; i < STATS_MAX_DEPTH; ++i) {
+		seen += s->depth_hist[i];
+		if (seen >= rank)
+			return i;
+	}
+	return s->max_depth;
+}
+
+// one line: shape,<label>,leaves,...; per-level violations as level:count
+static inline void stats_print(FILE* f, const char* label,
+		const tree_stats_t* s) {
+	const double optimal = s->leaves > 1 ? ceil(log2((double) s->leaves)) : 0;
+	fprintf(f, "shape,%s,leaves=%lu,height=%lu,optimal=%.0f,avg_depth=%.2f,"
+			"p50=%lu,p99=%lu,p99.9=%lu,violations=%lu,path_violations=%lu",
+			label, s->leaves,
+			s->max_depth, optimal,
+			s->leaves ? (double) s->depth_sum / s->leaves : 0,
+			stats_depth_percentile(s, 50), stats_depth_percentile(s, 99),
+			stats_depth_percentile(s, 99.9), s->violations,
+			s->path_violations);
+	fprintf(f, ",levels=(");
+	bool first = true;
+	for (int i = 0; i < STATS_MAX_DEPTH; ++i) {
+		if (!s->level_violations[i])
+			continue;
+		fprintf(f, first ? "%d:%lu" : " %d:%lu", i, s->level_violations[i]);
+		first = false;
+	}
+	fprintf(f, "),%s=(", stats_gap_name);
+	for (int i = 0; i < STATS_MAX_GAP; ++i)
+		fprintf(f, i ? " %lu" : "%lu", s->gap_hist[i]);
+	fprintf(f, ")\n");
+}
+
+// sleeps for duration ms, taking a shape sample every interval ms
+static inline void stats_series(FILE* f, const int duration,
+		const int interval, const int nthreads) {
+	struct timeval start, now;
+	tree_stats_t* s = (tree_stats_t*) malloc(sizeof(tree_stats_t));
+	if (!s) {
+		perror("malloc");
+		exit(1);
+	}
+	gettimeofday(&start, NULL);
+	while (true) {
+		gettimeofday(&now, NULL);
+		long elapsed = (now.tv_sec - start.tv_sec) * 1000
+				+ (now.tv_usec - start.tv_usec) / 1000;
+		if (elapsed >= duration)
+			break;
+		const long wait = duration - elapsed < interval ?
+				duration - elapsed : interval;
+		struct timespec pause = { wait / 1000, (wait % 1000) * 1000000 };
+		nanosleep(&pause, NULL);
+		gettimeofday(&now, NULL);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000
+				+ (now.tv_usec - start.tv_usec) / 1000;
+		if (elapsed >= duration)
+			break;
+		char label[32];
+		snprintf(label, sizeof(label), "%ldms", elapsed);
+		stats_clear(s);
+		tree_stats(s, nthreads);
+		stats_print(f, label, s);
+	}
+	free(s);
+}
+
+#endif /* TREE_STATS_H_ */
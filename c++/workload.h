@@ -0,0 +1,68 @@
+/*
+ * workload.h
+ *
+ *  Pre-generated per-thread operation streams. Each entry packs the
+ *  operation type into the top two bits of the key, so the timed loop
+ *  only reads one word per operation. Streams live in an anonymous
+ *  mapping, or in a shared mapping of a file when one is given.
+ */
+
+#ifndef WORKLOAD_H_
+#define WORKLOAD_H_
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define OP_GET					0
+#define OP_INSERT				1
+#define OP_DELETE				2
+
+#define STREAM_OP_SHIFT			62
+#define STREAM_KEY_MASK			((1UL << STREAM_OP_SHIFT) - 1)
+
+static inline unsigned long stream_pack(const int op, const unsigned long key) {
+	return ((unsigned long) op << STREAM_OP_SHIFT) | key;
+}
+
+static inline int stream_op(const unsigned long entry) {
+	return entry >> STREAM_OP_SHIFT;
+}
+
+static inline unsigned long stream_key(const unsigned long entry) {
+	return entry & STREAM_KEY_MASK;
+}
+
+// maps room for entries stream words; pages are touched by the thread
+// that generates them
+static inline unsigned long* stream_map(const char* file,
+		const unsigned long entries) {
+	const size_t bytes = entries * sizeof(unsigned long);
+	void* p;
+	if (file) {
+		const int fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || ftruncate(fd, bytes) != 0) {
+			perror(file);
+			exit(1);
+		}
+		p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+	} else {
+		p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	return (unsigned long*) p;
+}
+
+static inline void stream_unmap(unsigned long* stream,
+		const unsigned long entries) {
+	munmap(stream, entries * sizeof(unsigned long));
+}
+
+#endif /* WORKLOAD_H_ */
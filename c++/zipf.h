@@ -0,0 +1,146 @@
+/*
+ * zipf.h
+ *
+ *  Constant-memory Zipf sampler using rejection-inversion (Hormann and
+ *  Derflinger, "Rejection-inversion to generate variates from monotone
+ *  discrete distributions", 1996). Setup is O(1) for any range and a
+ *  sample costs one uniform draw plus a few log/exp on average.
+ *
+ *  The scrambled variant hashes the rank over [1, range], so the hot keys
+ *  are spread over the key space instead of sitting in one subtree.
+ */
+
+#ifndef ZIPF_H_
+#define ZIPF_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+// key_dist values for the samplers in this file, kept clear of the ones
+// handled by rand_gsl
+#define ZIPF_RI					16
+#define ZIPF_SCRAMBLED			17
+
+typedef struct zipf {
+	unsigned long range;
+	double alpha;
+	double h_integral_x1;
+	double h_integral_n;
+	double s;
+} zipf_t;
+
+// log1p(x) / x, accurate near 0
+static inline double zipf_helper1(const double x) {
+	if (fabs(x) > 1e-8)
+		return log1p(x) / x;
+	return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+// expm1(x) / x, accurate near 0
+static inline double zipf_helper2(const double x) {
+	if (fabs(x) > 1e-8)
+		return expm1(x) / x;
+	return 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static inline double zipf_h(const zipf_t* z, const double x) {
+	return exp(-z->alpha * log(x));
+}
+
+static inline double zipf_h_integral(const zipf_t* z, const double x) {
+	const double log_x = log(x);
+	return zipf_helper2((1 - z->alpha) * log_x) * log_x;
+}
+
+static inline double zipf_h_integral_inverse(const zipf_t* z, const double x) {
+	double t = x * (1 - z->alpha);
+	if (t < -1)
+		t = -1; // limit for rounding errors
+	return exp(zipf_helper1(t) * x);
+}
+
+static inline void zipf_init(zipf_t* z, const unsigned long range,
+		const double alpha) {
+	z->range = range;
+	z->alpha = alpha;
+	z->h_integral_x1 = zipf_h_integral(z, 1.5) - 1;
+	z->h_integral_n = zipf_h_integral(z, range + 0.5);
+	z->s = 2 - zipf_h_integral_inverse(z,
+			zipf_h_integral(z, 2.5) - zipf_h(z, 2));
+}
+
+// rank in [1, range], rank 1 being the most frequent
+static inline unsigned long zipf_rank(const zipf_t* z, gsl_rng* r) {
+	if (z->alpha <= 0)
+		return gsl_rng_uniform_int(r, z->range) + 1;
+	while (true) {
+		const double u = z->h_integral_n
+				+ gsl_rng_uniform(r) * (z->h_integral_x1 - z->h_integral_n);
+		const double x = zipf_h_integral_inverse(z, u);
+		unsigned long k = (unsigned long) (x + 0.5);
+		if (k < 1)
+			k = 1;
+		else if (k > z->range)
+			k = z->range;
+		if (k - x <= z->s || u >= zipf_h_integral(z, k + 0.5) - zipf_h(z, k))
+			return k;
+	}
+}
+
+// 64-bit finalizer (splitmix64): a bijection, so distinct ranks only
+// collide after the reduction to the range
+static inline unsigned long zipf_scramble(unsigned long x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9UL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebUL;
+	x ^= x >> 31;
+	return x;
+}
+
+static inline unsigned long zipf_next(const zipf_t* z, gsl_rng* r,
+		const bool scrambled) {
+	const unsigned long k = zipf_rank(z, r);
+	return scrambled ? zipf_scramble(k) % z->range + 1 : k;
+}
+
+static inline double zipf_elapsed_ms(const struct timeval* a,
+		const struct timeval* b) {
+	return (b->tv_sec - a->tv_sec) * 1000.0 + (b->tv_usec - a->tv_usec) / 1000.0;
+}
+
+// compares setup time and per-sample cost with the table based
+// initZipf/rand_gsl path of common_ops.h
+static inline void zipf_benchmark(gsl_rng* r, const unsigned long range,
+		const double alpha, const unsigned long samples) {
+	struct timeval t0, t1, t2;
+	unsigned long sum = 0;
+	zipf_t z;
+
+	gettimeofday(&t0, NULL);
+	initZipf(r, range, alpha);
+	gettimeofday(&t1, NULL);
+	for (unsigned long i = 0; i < samples; ++i)
+		sum += rand_gsl(r, range, ZIPF);
+	gettimeofday(&t2, NULL);
+	printf("sampler,table,%lu,%.2f,setup_ms=%.3f,ns_per_sample=%.1f\n", range,
+			alpha, zipf_elapsed_ms(&t0, &t1),
+			zipf_elapsed_ms(&t1, &t2) * 1e6 / samples);
+
+	for (int scrambled = 0; scrambled < 2; ++scrambled) {
+		gettimeofday(&t0, NULL);
+		zipf_init(&z, range, alpha);
+		gettimeofday(&t1, NULL);
+		for (unsigned long i = 0; i < samples; ++i)
+			sum += zipf_next(&z, r, scrambled);
+		gettimeofday(&t2, NULL);
+		printf("sampler,%s,%lu,%.2f,setup_ms=%.3f,ns_per_sample=%.1f\n",
+				scrambled ? "scrambled" : "rejection_inversion", range, alpha,
+				zipf_elapsed_ms(&t0, &t1),
+				zipf_elapsed_ms(&t1, &t2) * 1e6 / samples);
+	}
+	printf("sampler,checksum=%lu\n", sum);
+}
+
+#endif /* ZIPF_H_ */